@@ -0,0 +1,653 @@
+/**
+ * @file btree.cpp - BTreePage, BTreeFile and BTreeIndex implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include "btree.h"
+
+typedef u_int16_t u16;
+
+/* -------------BTreePage::DbBlock-------------*/
+BTreePage::BTreePage(Dbt &block, BlockID block_id, bool is_new) : DbBlock(block, block_id, is_new) {
+    if (is_new) {
+        this->num_entries = 0;
+        this->end_free = DbBlock::BLOCK_SZ;
+        this->fragmented = 0;
+        put_header();
+        set_kind(LEAF);
+        set_link(0);
+    } else {
+        this->num_entries = get_n(0);
+        this->end_free = get_n(2);
+        this->fragmented = get_n(4);
+    }
+}
+
+RecordID BTreePage::add(const Dbt *data) {
+    std::string entry((const char *) data->get_data(), data->get_size());
+    u16 key_size = entry.size() - (get_kind() == INTERIOR ? CHILD_SZ : 0);
+    RecordID i = upper_bound(entry.substr(0, key_size));
+    insert_at(i, entry.data(), entry.size());
+    return i;
+}
+
+Dbt *BTreePage::get(RecordID record_id) {
+    RecordView entry = view(record_id);
+    char *bytes = new char[entry.size];
+    memcpy(bytes, entry.data, entry.size);
+    return new Dbt(bytes, entry.size);
+}
+
+RecordView BTreePage::view(RecordID record_id) {
+    if (record_id == 0 || record_id > this->num_entries)
+        throw DbRecordIdNotFound("Record id does not exist: " + std::to_string(record_id));
+    return RecordView(data() + get_n(slot(record_id)), get_n(slot(record_id) + 2));
+}
+
+void BTreePage::put(RecordID record_id, const Dbt &data) {
+    RecordView old = view(record_id);
+    u16 size = data.get_size();
+    if (size > old.size && size - old.size > get_free_space())
+        throw DbBlockNoRoomError("Not enough room in block");
+    std::string entry((const char *) data.get_data(), size);
+    del(record_id);
+    insert_at(record_id, entry.data(), size);
+}
+
+void BTreePage::del(RecordID record_id) {
+    RecordView entry = view(record_id);
+    this->fragmented += entry.size;
+    memmove(data() + slot(record_id), data() + slot(record_id + 1), (this->num_entries - record_id) * 4);
+    this->num_entries--;
+    put_header();
+}
+
+RecordIDs *BTreePage::ids(void) {
+    RecordIDs *record_ids = new RecordIDs;
+    for (RecordID i = 1; i <= this->num_entries; i++)
+        record_ids->push_back(i);
+    return record_ids;
+}
+
+RecordID BTreePage::next_id(RecordID record_id) {
+    return record_id < this->num_entries ? record_id + 1 : 0;
+}
+
+u16 BTreePage::get_free_space(void) {
+    int free = (int) this->end_free - slot(this->num_entries + 2) + this->fragmented;
+    return free > 0 ? (u16) free : 0;
+}
+
+BlockID BTreePage::get_link(void) const {
+    BlockID link;
+    memcpy(&link, data() + 8, sizeof(link));
+    return link;
+}
+
+void BTreePage::set_link(BlockID link) {
+    memcpy(data() + 8, &link, sizeof(link));
+}
+
+RecordView BTreePage::key(RecordID i) const {
+    RecordView entry(data() + get_n(slot(i)), get_n(slot(i) + 2));
+    if (get_kind() == INTERIOR)
+        entry.size -= CHILD_SZ;
+    return entry;
+}
+
+BlockID BTreePage::child(RecordID i) const {
+    BlockID child;
+    memcpy(&child, data() + get_n(slot(i)) + get_n(slot(i) + 2) - CHILD_SZ, sizeof(child));
+    return child;
+}
+
+BlockID BTreePage::child_for(const std::string &key) const {
+    // the last entry <= key, or the link for keys below all of them
+    RecordID i = upper_bound(key) - 1;
+    return i == 0 ? get_link() : child(i);
+}
+
+void BTreePage::clear(void) {
+    this->num_entries = 0;
+    this->end_free = DbBlock::BLOCK_SZ;
+    this->fragmented = 0;
+    put_header();
+}
+
+RecordID BTreePage::lower_bound(const std::string &key) const {
+    RecordID low = 1, high = this->num_entries + 1;
+    while (low < high) {
+        RecordID mid = (low + high) / 2;
+        RecordView k = this->key(mid);
+        if (compare(k.data, k.size, key.data(), key.size()) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+RecordID BTreePage::upper_bound(const std::string &key) const {
+    RecordID low = 1, high = this->num_entries + 1;
+    while (low < high) {
+        RecordID mid = (low + high) / 2;
+        RecordView k = this->key(mid);
+        if (compare(k.data, k.size, key.data(), key.size()) <= 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+void BTreePage::insert(const std::string &key, BlockID child) {
+    std::string entry = key;
+    if (get_kind() == INTERIOR)
+        entry.append((const char *) &child, CHILD_SZ);
+    insert_at(upper_bound(key), entry.data(), entry.size());
+}
+
+std::string BTreePage::split(BTreePage &right) {
+    // find where the bytes pass the halfway mark
+    u16 total = 0;
+    for (RecordID i = 1; i <= this->num_entries; i++)
+        total += get_n(slot(i) + 2);
+    u16 bytes = 0;
+    RecordID first_moved = 1;
+    while (first_moved < this->num_entries && bytes + get_n(slot(first_moved) + 2) <= total / 2)
+        bytes += get_n(slot(first_moved++) + 2);
+    if (first_moved == 1)
+        first_moved = 2;
+
+    std::string separator(key(first_moved).data, key(first_moved).size);
+    RecordID moving = first_moved;
+    if (get_kind() == INTERIOR) {
+        // pushed up: its child takes keys from the separator up to right's first entry
+        right.set_link(child(first_moved));
+        moving++;
+    } else {
+        right.set_link(get_link());
+        set_link(right.get_block_id());
+    }
+    for (RecordID i = moving; i <= this->num_entries; i++)
+        right.insert_at(right.size() + 1, data() + get_n(slot(i)), get_n(slot(i) + 2));
+    while (this->num_entries >= first_moved)
+        del(this->num_entries);
+    return separator;
+}
+
+int BTreePage::compare(const char *a, size_t a_size, const char *b, size_t b_size) {
+    int comparison = memcmp(a, b, std::min(a_size, b_size));
+    if (comparison != 0)
+        return comparison;
+    return a_size < b_size ? -1 : a_size > b_size ? 1 : 0;
+}
+
+// protected
+u16 BTreePage::get_n(u16 offset) const {
+    u16 n;
+    memcpy(&n, data() + offset, sizeof(n));
+    return n;
+}
+
+void BTreePage::put_n(u16 offset, u16 n) {
+    memcpy(data() + offset, &n, sizeof(n));
+}
+
+void BTreePage::put_header(void) {
+    put_n(0, this->num_entries);
+    put_n(2, this->end_free);
+    put_n(4, this->fragmented);
+}
+
+void BTreePage::insert_at(RecordID i, const char *bytes, u16 size) {
+    if (size > get_free_space())
+        throw DbBlockNoRoomError("not enough room for new record");
+    if (this->end_free < slot(this->num_entries + 2) + size)
+        compact();
+    memmove(data() + slot(i + 1), data() + slot(i), (this->num_entries - i + 1) * 4);
+    this->end_free -= size;
+    memcpy(data() + this->end_free, bytes, size);
+    put_n(slot(i), this->end_free);
+    put_n(slot(i) + 2, size);
+    this->num_entries++;
+    put_header();
+}
+
+bool BTreePage::compact(void) {
+    if (this->fragmented == 0)
+        return false;
+    char old[DbBlock::BLOCK_SZ];
+    memcpy(old, data(), DbBlock::BLOCK_SZ);
+    this->end_free = DbBlock::BLOCK_SZ;
+    for (RecordID i = 1; i <= this->num_entries; i++) {
+        u16 offset, size;
+        memcpy(&offset, old + slot(i), sizeof(offset));
+        memcpy(&size, old + slot(i) + 2, sizeof(size));
+        this->end_free -= size;
+        memcpy(data() + this->end_free, old + offset, size);
+        put_n(slot(i), this->end_free);
+    }
+    this->fragmented = 0;
+    put_header();
+    return true;
+}
+
+/* -------------BTreeFile::HeapFile-------------*/
+DbBlock *BTreeFile::make_block(Dbt &data, BlockID block_id, bool is_new) {
+    return new BTreePage(data, block_id, is_new);
+}
+
+/* -------------IndexKey-------------*/
+IndexKey::IndexKey(DbRelation &relation, const ColumnNames &key_columns)
+    : relation(relation), key_columns(key_columns) {
+    const ColumnNames &column_names = relation.get_column_names();
+    for (auto const& column_name: key_columns) {
+        auto found = std::find(column_names.begin(), column_names.end(), column_name);
+        if (found == column_names.end())
+            throw DbRelationError("unknown column " + column_name);
+        ColumnAttribute ca = relation.get_column_attributes()[found - column_names.begin()];
+        this->key_types.push_back(ca.get_data_type());
+    }
+}
+
+std::string IndexKey::encode(const ValueDict *key_values) const {
+    std::string key;
+    for (uint i = 0; i < this->key_columns.size(); i++) {
+        auto found = key_values->find(this->key_columns[i]);
+        if (found == key_values->end())
+            throw DbRelationError("key is missing column " + this->key_columns[i]);
+        const Value &value = found->second;
+        if (value.data_type != this->key_types[i])
+            throw DbRelationError("wrong type of value for column " + this->key_columns[i]);
+        if (value.data_type == ColumnAttribute::DataType::INT) {
+            // big-endian with the sign bit flipped sorts like the numbers
+            u_int32_t n = (u_int32_t) value.n ^ 0x80000000u;
+            for (int shift = 24; shift >= 0; shift -= 8)
+                key += (char) ((n >> shift) & 0xff);
+        } else {
+            const char *text = value.text_data();
+            for (size_t i = 0; i < value.text_size(); i++) {
+                char c = text[i];
+                key += c;
+                if (c == '\0')
+                    key += '\xff';
+            }
+            key.append(2, '\0');
+        }
+    }
+    if (key.size() + HANDLE_SZ > MAX_ENTRY_SZ)
+        throw DbRelationError("key too long for an index");
+    return key;
+}
+
+std::string IndexKey::entry(Handle handle) const {
+    ValueDict *key_values = relation.project(handle, &this->key_columns);
+    std::string key;
+    if (key_values->size() < this->key_columns.size()) {
+        delete key_values; // a null in the key (project leaves it out): not indexed
+        return key;
+    }
+    try {
+        key = encode(key_values);
+    } catch (...) {
+        delete key_values;
+        throw;
+    }
+    delete key_values;
+    for (int shift = 24; shift >= 0; shift -= 8)
+        key += (char) ((handle.first >> shift) & 0xff);
+    key += (char) ((handle.second >> 8) & 0xff);
+    key += (char) (handle.second & 0xff);
+    return key;
+}
+
+void IndexKey::check(const ValueDict *row) const {
+    for (auto const& column_name: this->key_columns)
+        if (row->find(column_name) == row->end())
+            return;
+    encode(row);
+}
+
+Handle IndexKey::handle(const RecordView &entry) {
+    const unsigned char *h = (const unsigned char *) entry.data + entry.size - HANDLE_SZ;
+    BlockID block_id = ((BlockID) h[0] << 24) | ((BlockID) h[1] << 16) | ((BlockID) h[2] << 8) | h[3];
+    RecordID record_id = (RecordID) ((h[4] << 8) | h[5]);
+    return std::make_pair(block_id, record_id);
+}
+
+/* -------------BTreeIndex::DbIndex-------------*/
+BTreeIndex::BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns)
+    : DbIndex(relation, name, key_columns), file(relation.get_table_name() + "-" + name), pool(file), root(0),
+      keys(relation, key_columns) {}
+
+BTreeIndex::~BTreeIndex() {
+    if (file.is_open())
+        close();
+}
+
+void BTreeIndex::create() {
+    pool.discard();
+    file.create();
+    // block 1 (made by create) points at the root, a leaf to start with
+    BTreePage *meta = pin(1);
+    BTreePage *leaf = (BTreePage *) pool.pin_new();
+    this->root = leaf->get_block_id();
+    meta->set_kind(BTreePage::META);
+    meta->set_link(this->root);
+    pool.unpin(leaf, true);
+    pool.unpin(meta, true);
+    // then every row already in the table
+    DbRelationCursor *cursor = relation.scan();
+    Handle handle;
+    try {
+        while (cursor->next(handle))
+            insert(handle);
+    } catch (...) {
+        delete cursor;
+        throw;
+    }
+    delete cursor;
+}
+
+void BTreeIndex::drop() {
+    pool.discard();
+    file.open(); // the file only knows its path once opened
+    file.drop();
+}
+
+void BTreeIndex::open() {
+    if (file.is_open())
+        return;
+    file.open();
+    BTreePage *meta = pin(1);
+    this->root = meta->get_link();
+    pool.unpin(meta);
+}
+
+void BTreeIndex::close() {
+    pool.flush();
+    pool.discard();
+    file.close();
+}
+
+Handles *BTreeIndex::lookup(const ValueDict *key_values) {
+    // the key's encoding can't be a prefix of another key's, so its entries are exactly
+    // the ones that start with it
+    std::string key = keys.encode(key_values);
+    return scan_from(key, [&key](const RecordView &entry) {
+        return entry.size >= key.size() && memcmp(entry.data, key.data(), key.size()) == 0;
+    });
+}
+
+Handles *BTreeIndex::range(const ValueDict *min_key, const ValueDict *max_key) {
+    std::string start = min_key == nullptr ? std::string() : keys.encode(min_key);
+    if (max_key == nullptr)
+        return scan_from(start, [](const RecordView &entry) { return true; });
+    std::string stop = keys.encode(max_key);
+    return scan_from(start, [&stop](const RecordView &entry) {
+        return BTreePage::compare(entry.data, entry.size - IndexKey::HANDLE_SZ, stop.data(), stop.size()) <= 0;
+    });
+}
+
+void BTreeIndex::check(const ValueDict *row) {
+    keys.check(row);
+}
+
+void BTreeIndex::insert(Handle handle) {
+    std::string key = keys.entry(handle);
+    if (key.empty())
+        return;
+    std::vector<BlockID> path;
+    BlockID leaf_id = find_leaf(key, &path);
+    BTreePage *leaf = pin(leaf_id);
+    RecordID i = leaf->lower_bound(key);
+    if (i <= leaf->size()) {
+        RecordView found = leaf->key(i);
+        if (BTreePage::compare(found.data, found.size, key.data(), key.size()) == 0) {
+            pool.unpin(leaf);
+            return;
+        }
+    }
+    if (key.size() <= leaf->get_free_space()) {
+        leaf->insert(key);
+        pool.unpin(leaf, true);
+        return;
+    }
+    // full: split it and add the new right half to the parent
+    BTreePage *right = nullptr;
+    std::string separator;
+    try {
+        right = (BTreePage *) pool.pin_new();
+        separator = leaf->split(*right);
+        if (BTreePage::compare(key.data(), key.size(), separator.data(), separator.size()) < 0)
+            leaf->insert(key);
+        else
+            right->insert(key);
+    } catch (...) {
+        if (right != nullptr)
+            pool.unpin(right, true);
+        pool.unpin(leaf, true);
+        throw;
+    }
+    BlockID right_id = right->get_block_id();
+    pool.unpin(right, true);
+    pool.unpin(leaf, true);
+    insert_in_parent(path, separator, leaf_id, right_id);
+}
+
+void BTreeIndex::del(Handle handle) {
+    std::string key = keys.entry(handle);
+    if (key.empty())
+        return;
+    BTreePage *leaf = pin(find_leaf(key));
+    RecordID i = leaf->lower_bound(key);
+    bool found = false;
+    if (i <= leaf->size()) {
+        RecordView k = leaf->key(i);
+        found = BTreePage::compare(k.data, k.size, key.data(), key.size()) == 0;
+    }
+    if (found)
+        leaf->del(i);
+    pool.unpin(leaf, found);
+    if (!found)
+        throw DbRelationError("row is not in index " + this->name);
+}
+
+// protected
+BlockID BTreeIndex::find_leaf(const std::string &key, std::vector<BlockID> *path) {
+    BlockID block_id = this->root;
+    while (true) {
+        BTreePage *node = pin(block_id);
+        if (node->get_kind() == BTreePage::LEAF) {
+            pool.unpin(node);
+            return block_id;
+        }
+        if (path != nullptr)
+            path->push_back(block_id);
+        BlockID child = node->child_for(key);
+        pool.unpin(node);
+        block_id = child;
+    }
+}
+
+void BTreeIndex::insert_in_parent(std::vector<BlockID> &path, const std::string &separator,
+                                  BlockID left, BlockID right) {
+    if (path.empty()) {
+        // the root split: grow a level
+        BTreePage *new_root = (BTreePage *) pool.pin_new();
+        new_root->set_kind(BTreePage::INTERIOR);
+        new_root->set_link(left);
+        new_root->insert(separator, right);
+        this->root = new_root->get_block_id();
+        pool.unpin(new_root, true);
+        BTreePage *meta = pin(1);
+        meta->set_link(this->root);
+        pool.unpin(meta, true);
+        return;
+    }
+    BlockID parent_id = path.back();
+    path.pop_back();
+    BTreePage *parent = pin(parent_id);
+    if (separator.size() + BTreePage::CHILD_SZ <= parent->get_free_space()) {
+        parent->insert(separator, right);
+        pool.unpin(parent, true);
+        return;
+    }
+    BTreePage *sibling = (BTreePage *) pool.pin_new();
+    sibling->set_kind(BTreePage::INTERIOR);
+    std::string pushed_up = parent->split(*sibling);
+    if (BTreePage::compare(separator.data(), separator.size(), pushed_up.data(), pushed_up.size()) < 0)
+        parent->insert(separator, right);
+    else
+        sibling->insert(separator, right);
+    BlockID sibling_id = sibling->get_block_id();
+    pool.unpin(sibling, true);
+    pool.unpin(parent, true);
+    insert_in_parent(path, pushed_up, parent_id, sibling_id);
+}
+
+template<typename Keep>
+Handles *BTreeIndex::scan_from(const std::string &start, Keep keep) {
+    Handles *handles = new Handles();
+    BlockID leaf_id = find_leaf(start);
+    BTreePage *leaf = pin(leaf_id);
+    RecordID i = leaf->lower_bound(start);
+    while (true) {
+        if (i > leaf->size()) {
+            // on to the right sibling
+            BlockID next = leaf->get_link();
+            pool.unpin(leaf);
+            if (next == 0)
+                break;
+            leaf = pin(next);
+            i = 1;
+            continue;
+        }
+        RecordView entry = leaf->key(i++);
+        if (!keep(entry)) {
+            pool.unpin(leaf);
+            break;
+        }
+        handles->push_back(IndexKey::handle(entry));
+    }
+    return handles;
+}
+
+/*
+ * Index test: enough rows for the tree to split its leaves and root, some indexed as the
+ * index is built, the rest as they are inserted or bulk loaded
+ */
+bool test_btree_index() {
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    ColumnAttribute ca(ColumnAttribute::INT);
+    column_attributes.push_back(ca);
+    ca.set_data_type(ColumnAttribute::TEXT);
+    column_attributes.push_back(ca);
+    HeapTable table("_test_btree_cpp", column_names, column_attributes);
+    table.create();
+    ColumnNames key_columns;
+    key_columns.push_back("a");
+    BTreeIndex index(table, "fxx", key_columns);
+    Handles handles;
+    for (int32_t i = 0; i < 5000; i++) {
+        if (i == 1000) {
+            index.create();
+            table.add_index(&index);
+        }
+        ValueDict row;
+        row["a"] = Value(i);
+        row["b"] = Value("b" + std::to_string(i % 7));
+        handles.push_back(table.insert(&row));
+    }
+    std::ostringstream csv;
+    for (int32_t i = 5000; i < 6000; i++)
+        csv << i << ",b" << i % 7 << "\n";
+    std::istringstream in(csv.str());
+    bool ok = table.bulk_load(in) == 1000;
+    index.close();
+    index.open();
+    for (int32_t i = 0; i < 6000 && ok; i++) {
+        ValueDict key;
+        key["a"] = Value(i);
+        Handles *found = index.lookup(&key);
+        ok = found->size() == 1 && (i >= 5000 || (*found)[0] == handles[i]);
+        delete found;
+    }
+    if (!ok)
+        return false;
+    std::cout << "btree lookup ok" << std::endl;
+    ValueDict min_key, max_key;
+    min_key["a"] = Value(1000);
+    max_key["a"] = Value(1999);
+    Handles *found = index.range(&min_key, &max_key);
+    ok = found->size() == 1000;
+    delete found;
+    Predicates where = {Predicate("a", Predicate::GE, Value(4990)), Predicate("a", Predicate::LT, Value(5010)),
+                        Predicate("b", Predicate::EQ, Value("b3"))};
+    found = table.select(&where);
+    ok = ok && found->size() == 3;
+    delete found;
+    if (!ok)
+        return false;
+    std::cout << "btree range ok" << std::endl;
+    // deletes and key changes take their entries with them
+    for (int32_t i = 0; i < 5000; i += 5) {
+        table.del(handles[i]);
+        ValueDict change;
+        change["a"] = Value(i + 100001);
+        table.update(handles[i + 1], &change);
+    }
+    for (int32_t i = 0; i < 5000 && ok; i++) {
+        ValueDict key;
+        key["a"] = Value(i);
+        found = index.lookup(&key);
+        ok = i % 5 <= 1 ? found->empty() : found->size() == 1 && (*found)[0] == handles[i];
+        delete found;
+        if (ok && i % 5 == 1) {
+            key["a"] = Value(i + 100000);
+            found = index.lookup(&key);
+            ok = found->size() == 1 && (*found)[0] == handles[i];
+            delete found;
+        }
+    }
+    if (!ok)
+        return false;
+    std::cout << "btree del ok" << std::endl;
+    // a key too long for the index keeps the row out of the table as well
+    BTreeIndex long_keys(table, "fyy", ColumnNames(1, "b"));
+    long_keys.create();
+    table.add_index(&long_keys);
+    ValueDict row;
+    row["a"] = Value(-1);
+    row["b"] = Value(std::string(IndexKey::MAX_ENTRY_SZ, 'b'));
+    try {
+        table.insert(&row);
+        ok = false;
+    } catch (DbRelationError &e) {
+    }
+    ValueDict key;
+    key["a"] = Value(-1);
+    found = index.lookup(&key);
+    Handles *all = table.select();
+    ok = ok && found->empty() && all->size() == 5000;
+    delete found;
+    delete all;
+    table.remove_index(&long_keys);
+    long_keys.drop();
+    table.remove_index(&index);
+    index.drop();
+    table.drop();
+    if (!ok)
+        return false;
+    std::cout << "btree check ok" << std::endl;
+    return true;
+}
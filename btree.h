@@ -0,0 +1,326 @@
+/**
+ * @file btree.h - B+tree implementation of DbIndex.
+ * BTreePage: DbBlock
+ * BTreeFile: HeapFile
+ * IndexKey
+ * BTreeIndex: DbIndex
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include "heap_storage.h"
+
+/**
+ * @class BTreePage - one node of a B+tree: variable-length entries kept sorted by key.
+ *
+ *      Entries are byte strings. A leaf entry is just its key; an interior entry is a key followed
+        by the 4-byte id of the child holding keys >= it. Record id i is the i-th entry in key
+        order, so ids shift as entries come and go.
+            Bytes 0x00 - 0x01: number of entries
+            Bytes 0x02 - 0x03: offset to the start of the entry bytes (they grow down from the end)
+            Bytes 0x04 - 0x05: number of fragmented bytes (left behind by removed entries)
+            Byte  0x06:        kind: LEAF, INTERIOR or META
+            Bytes 0x08 - 0x0B: link: a leaf's right sibling, an interior node's child for keys
+                               below its first entry, the META block's root
+            Bytes 0x0C - 0x0D: offset to entry 1
+            Bytes 0x0E - 0x0F: size of entry 1
+            etc.
+ */
+class BTreePage : public DbBlock {
+public:
+    enum Kind {
+        LEAF, INTERIOR, META
+    };
+
+    static const u_int16_t HEADER_SZ = 12;
+    static const u_int16_t CHILD_SZ = sizeof(BlockID);
+
+    /**
+     * @param block the block's memory
+     * @param block_id its id
+     * @param is_new whether to format it as an empty leaf
+     */
+    BTreePage(Dbt &block, BlockID block_id, bool is_new = false);
+
+    virtual ~BTreePage() {}
+
+    BTreePage(const BTreePage &other) = delete;
+
+    BTreePage(BTreePage &&temp) = delete;
+
+    BTreePage &operator=(const BTreePage &other) = delete;
+
+    BTreePage &operator=(BTreePage &&temp) = delete;
+
+    /**
+     * insert an entry in key order
+     * @return its record id (position)
+     * @throws DbBlockNoRoomError if it doesn't fit
+     */
+    virtual RecordID add(const Dbt *data);
+
+    virtual Dbt *get(RecordID record_id);
+
+    virtual RecordView view(RecordID record_id);
+
+    /**
+     * replace an entry (the caller keeps the order intact)
+     */
+    virtual void put(RecordID record_id, const Dbt &data);
+
+    /**
+     * remove an entry; the ones after it move down one position
+     */
+    virtual void del(RecordID record_id);
+
+    virtual RecordIDs *ids(void);
+
+    virtual RecordID next_id(RecordID record_id = 0);
+
+    /**
+     * the largest entry that still fits
+     */
+    virtual u_int16_t get_free_space(void);
+
+    /**
+     * squeeze out the fragmented bytes in one pass
+     * @return false if there were none
+     */
+    virtual bool compact(void);
+
+    Kind get_kind(void) const { return (Kind) data()[6]; }
+
+    void set_kind(Kind kind) { data()[6] = (char) kind; }
+
+    BlockID get_link(void) const;
+
+    void set_link(BlockID link);
+
+    /**
+     * number of entries
+     */
+    u_int16_t size(void) const { return num_entries; }
+
+    /**
+     * the key part of entry i (1-based)
+     */
+    RecordView key(RecordID i) const;
+
+    /**
+     * the child an interior node's entry i points to
+     */
+    BlockID child(RecordID i) const;
+
+    /**
+     * the child of an interior node to look in for a key
+     */
+    BlockID child_for(const std::string &key) const;
+
+    /**
+     * remove every entry (kind and link are kept)
+     */
+    void clear(void);
+
+    /**
+     * position of the first entry whose key is >= key (size() + 1 if none)
+     */
+    RecordID lower_bound(const std::string &key) const;
+
+    /**
+     * position of the first entry whose key is > key (size() + 1 if none)
+     */
+    RecordID upper_bound(const std::string &key) const;
+
+    /**
+     * insert an entry (an interior one if child != 0) where it belongs in key order
+     * @throws DbBlockNoRoomError if it doesn't fit
+     */
+    void insert(const std::string &key, BlockID child = 0);
+
+    /**
+     * move the upper half of the entries (by bytes) to an empty node, linking leaves.
+     * For interior nodes the first moved entry is pushed up instead: it is removed and its
+     * child becomes right's link.
+     * @param right an empty node of the same kind
+     * @return the separator key to insert into the parent
+     */
+    std::string split(BTreePage &right);
+
+    /**
+     * compare two keys bytewise (a proper prefix is smaller)
+     */
+    static int compare(const char *a, size_t a_size, const char *b, size_t b_size);
+
+protected:
+    u_int16_t num_entries;
+    u_int16_t end_free; // first byte of entry data
+    u_int16_t fragmented; // bytes of removed entries, reclaimed by compact()
+
+    char *data(void) const { return (char *) this->block.get_data(); }
+
+    u_int16_t get_n(u_int16_t offset) const;
+
+    void put_n(u_int16_t offset, u_int16_t n);
+
+    void put_header(void);
+
+    /**
+     * offset of entry i's slot (its offset and size)
+     */
+    u_int16_t slot(RecordID i) const { return HEADER_SZ + (i - 1) * 2 * sizeof(u_int16_t); }
+
+    /**
+     * put an entry at position i, moving later ones up
+     */
+    void insert_at(RecordID i, const char *bytes, u_int16_t size);
+};
+
+/**
+ * @class BTreeFile - block file of BTreePages (a heap file in every other respect)
+ */
+class BTreeFile : public HeapFile {
+public:
+    BTreeFile(std::string name) : HeapFile(name) {}
+
+    virtual ~BTreeFile() {}
+
+    virtual DbBlock *make_block(Dbt &data, BlockID block_id, bool is_new);
+};
+
+/**
+ * @class IndexKey - the byte strings an index keeps for a table's rows
+ *
+ *      Keys are encoded so that comparing the bytes compares the key values: INT as big-endian
+        with the sign flipped, TEXT with its zero bytes escaped (00 FF) and a 00 00 terminator, so
+        no key's encoding is a prefix of another's. An entry is a row's key followed by its handle
+        (big-endian), so duplicate keys are still distinct entries.
+ */
+class IndexKey {
+public:
+    static const u_int16_t MAX_ENTRY_SZ = 1024; // so at least three entries fit in a BTreePage
+    static const u_int16_t HANDLE_SZ = sizeof(BlockID) + sizeof(RecordID);
+
+    /**
+     * @param relation the indexed table
+     * @param key_columns columns of the key, in order
+     * @throws DbRelationError for an unknown column
+     */
+    IndexKey(DbRelation &relation, const ColumnNames &key_columns);
+
+    /**
+     * the byte string for a key
+     * @throws DbRelationError if a key column is missing or has the wrong type, or the key is too long
+     */
+    std::string encode(const ValueDict *key_values) const;
+
+    /**
+     * the entry for a row: its key followed by its handle, or "" if part of its key is
+     * null (such rows are left out of indexes)
+     */
+    std::string entry(Handle handle) const;
+
+    /**
+     * check that a new row's entry can be made (see DbIndex::check)
+     * @param row the row's values, a row with part of its key null being fine
+     * @throws DbRelationError if its key is too long or has the wrong types
+     */
+    void check(const ValueDict *row) const;
+
+    /**
+     * the handle at the end of an entry
+     */
+    static Handle handle(const RecordView &entry);
+
+protected:
+    DbRelation &relation;
+    ColumnNames key_columns;
+    std::vector<ColumnAttribute::DataType> key_types; // of key_columns
+};
+
+/**
+ * @class BTreeIndex - B+tree on one or more INT/TEXT columns, mapping keys to Handles
+ *
+ *      Kept in its own file, <table>-<index>.db, of BTreePages: block 1 holds the root's id,
+        the rest are nodes, cached by a BufferPool. Leaf entries are IndexKey entries, so keys
+        sort by value and del() finds exactly one entry.
+        A lookup reads one node per level: logarithmic in the number of rows.
+        Nodes are split when full but not merged when they empty out.
+ */
+class BTreeIndex : public DbIndex {
+public:
+    /**
+     * @param relation the indexed table
+     * @param name index name
+     * @param key_columns columns of the key, in order
+     * @throws DbRelationError for an unknown column
+     */
+    BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns);
+
+    virtual ~BTreeIndex();
+
+    BTreeIndex(const BTreeIndex &other) = delete;
+
+    BTreeIndex &operator=(const BTreeIndex &other) = delete;
+
+    virtual void create();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual Handles *lookup(const ValueDict *key_values);
+
+    virtual Handles *range(const ValueDict *min_key, const ValueDict *max_key);
+
+    virtual void insert(Handle handle);
+
+    virtual void check(const ValueDict *row);
+
+    virtual void del(Handle handle);
+
+    virtual bool is_ordered() const { return true; }
+
+protected:
+    BTreeFile file;
+    BufferPool pool; // the index's nodes
+    BlockID root;
+    IndexKey keys;
+
+    BTreePage *pin(BlockID block_id) { return (BTreePage *) pool.pin(block_id); }
+
+    /**
+     * walk down from the root to the leaf where key belongs
+     * @param key (encoded)
+     * @param path if given, gets the interior nodes passed, root first
+     * @return the leaf's id
+     */
+    BlockID find_leaf(const std::string &key, std::vector<BlockID> *path = nullptr);
+
+    /**
+     * after a split, insert the separator for a new node into the parent, splitting it too
+     * if needed (and growing a new root at the top)
+     * @param path interior nodes from the root down to the parent
+     * @param separator the new node's lowest key
+     * @param left the node that was split
+     * @param right the new node
+     */
+    void insert_in_parent(std::vector<BlockID> &path, const std::string &separator, BlockID left, BlockID right);
+
+    /**
+     * handles of the leaf entries from the first one >= start, in order, while keep() holds
+     */
+    template<typename Keep>
+    Handles *scan_from(const std::string &start, Keep keep);
+};
+
+/**
+ * Index test (run by the shell's "test" command)
+ */
+bool test_btree_index();
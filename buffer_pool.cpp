@@ -0,0 +1,145 @@
+/**
+ * @file buffer_pool.cpp - BufferPool implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include "buffer_pool.h"
+
+BufferPool::BufferPool(DbFile &file, uint num_frames)
+    : file(file), frames(num_frames), hand(0), hits(0), misses(0) {}
+
+BufferPool::~BufferPool() {
+    for (auto &frame: this->frames)
+        delete frame.block;
+}
+
+DbBlock* BufferPool::pin(BlockID block_id) {
+    auto cached = this->page_table.find(block_id);
+    if (cached != this->page_table.end()) {
+        Frame &frame = this->frames[cached->second];
+        frame.pin_count++;
+        frame.referenced = true;
+        this->hits++;
+        return frame.block;
+    }
+    this->misses++;
+    uint i = victim();
+    Frame &frame = this->frames[i];
+    frame.block = this->file.get(block_id, frame.data);
+    frame.pin_count = 1;
+    frame.dirty = false;
+    frame.referenced = true;
+    this->page_table[block_id] = i;
+    return frame.block;
+}
+
+DbBlock* BufferPool::pin_cached(BlockID block_id) {
+    auto cached = this->page_table.find(block_id);
+    if (cached == this->page_table.end())
+        return nullptr;
+    Frame &frame = this->frames[cached->second];
+    frame.pin_count++;
+    frame.referenced = true;
+    this->hits++;
+    return frame.block;
+}
+
+DbBlock* BufferPool::pin_new(void) {
+    uint i = victim();
+    Frame &frame = this->frames[i];
+    frame.block = this->file.get_new(frame.data);
+    frame.pin_count = 1;
+    frame.dirty = true;
+    frame.referenced = true;
+    this->page_table[frame.block->get_block_id()] = i;
+    return frame.block;
+}
+
+void BufferPool::unpin(DbBlock *block, bool dirty) {
+    Frame &frame = frame_of(block);
+    if (frame.pin_count > 0)
+        frame.pin_count--;
+    frame.dirty = frame.dirty || dirty;
+}
+
+void BufferPool::set_dirty(DbBlock *block) {
+    frame_of(block).dirty = true;
+}
+
+void BufferPool::flush(void) {
+    for (auto &frame: this->frames) {
+        if (frame.block != nullptr && frame.dirty) {
+            this->file.put(frame.block);
+            frame.dirty = false;
+        }
+    }
+}
+
+void BufferPool::flush(DbBlock *block) {
+    Frame &frame = frame_of(block);
+    if (frame.dirty) {
+        this->file.put(frame.block);
+        frame.dirty = false;
+    }
+}
+
+void BufferPool::discard(void) {
+    for (auto &frame: this->frames) {
+        delete frame.block;
+        frame.clear();
+    }
+    this->page_table.clear();
+    this->hand = 0;
+}
+
+void BufferPool::discard(BlockID last) {
+    for (auto &frame: this->frames) {
+        if (frame.block == nullptr || frame.block->get_block_id() <= last)
+            continue;
+        this->page_table.erase(frame.block->get_block_id());
+        delete frame.block;
+        frame.clear();
+    }
+}
+
+void BufferPool::resize(uint num_frames) {
+    flush();
+    discard();
+    // frames hold the blocks' memory, so only reallocate them once they are all empty
+    this->frames = std::vector<Frame>(num_frames);
+}
+
+// protected
+uint BufferPool::victim(void) {
+    uint n = this->frames.size();
+    // two sweeps: the first may only be clearing reference bits
+    for (uint step = 0; step < 2 * n; step++) {
+        uint i = this->hand;
+        this->hand = (this->hand + 1) % n;
+        Frame &frame = this->frames[i];
+        if (frame.block == nullptr)
+            return i;
+        if (frame.pin_count > 0)
+            continue;
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+        if (frame.dirty)
+            this->file.put(frame.block);
+        this->page_table.erase(frame.block->get_block_id());
+        delete frame.block;
+        frame.clear();
+        return i;
+    }
+    throw DbBufferPoolFullError("all " + std::to_string(n) + " buffer frames are pinned");
+}
+
+BufferPool::Frame& BufferPool::frame_of(DbBlock *block) {
+    auto cached = this->page_table.find(block->get_block_id());
+    if (cached == this->page_table.end())
+        throw std::invalid_argument("block " + std::to_string(block->get_block_id()) + " is not pinned");
+    return this->frames[cached->second];
+}
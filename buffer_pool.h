@@ -0,0 +1,171 @@
+/**
+ * @file buffer_pool.h - Buffer manager sitting between a DbRelation and its DbFile.
+ * BufferPool
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "storage_engine.h"
+
+/**
+ * Thrown when every frame is pinned and a new block has to come in.
+ */
+typedef std::runtime_error DbBufferPoolFullError;
+
+/**
+ * @class BufferPool - fixed array of block-sized frames caching one DbFile's blocks.
+ *
+ *      pin() hands out the DbBlock living in a frame, reading it from the file only on a miss,
+        and keeps it there until the matching unpin(). Unpinned frames stay cached; when a frame
+        is needed the CLOCK hand sweeps past pinned frames, gives recently used ones a second
+        chance, and evicts the first cold one, writing it back first if it is dirty.
+        So a hot block costs a hash lookup instead of a file read plus two allocations.
+ */
+class BufferPool {
+public:
+    static const uint DEFAULT_FRAMES = 64; // frames per pool unless told otherwise
+
+    /**
+     * constructor
+     * @param file the file whose blocks are cached (the pool never opens or closes it)
+     * @param num_frames how many blocks to keep in memory
+     */
+    BufferPool(DbFile &file, uint num_frames = DEFAULT_FRAMES);
+
+    // frees the frames without writing them; flush() first if they matter
+    virtual ~BufferPool();
+
+    // not implemented
+    BufferPool(const BufferPool &other) = delete;
+
+    // not implemented
+    BufferPool &operator=(const BufferPool &other) = delete;
+
+    /**
+     * get a block and keep it in memory until it is unpinned.
+     * @param block_id which block
+     * @return the block, valid until the matching unpin()
+     */
+    virtual DbBlock *pin(BlockID block_id);
+
+    /**
+     * pin a block only if it is already in memory, never reading the file.
+     * @param block_id which block
+     * @return the block (unpin it later), or nullptr if it is not cached
+     */
+    virtual DbBlock *pin_cached(BlockID block_id);
+
+    /**
+     * add a new empty block to the file and pin it (it starts out dirty).
+     * @return the new block, valid until the matching unpin()
+     */
+    virtual DbBlock *pin_new(void);
+
+    /**
+     * give back a block from pin() or pin_new().
+     * @param block the pinned block
+     * @param dirty whether it was modified (it is written back before its frame is reused)
+     */
+    virtual void unpin(DbBlock *block, bool dirty = false);
+
+    /**
+     * note that a block still pinned has been modified (unpin(block, true) does this too).
+     * @param block a block from pin() or pin_new()
+     */
+    virtual void set_dirty(DbBlock *block);
+
+    /**
+     * write every dirty frame back to the file; they stay cached.
+     */
+    virtual void flush(void);
+
+    /**
+     * write one block back to the file now if it is dirty (it stays cached).
+     * @param block a block from pin() or pin_new()
+     */
+    virtual void flush(DbBlock *block);
+
+    /**
+     * forget every cached block without writing it (the file was dropped or truncated).
+     */
+    virtual void discard(void);
+
+    /**
+     * forget the cached blocks after a given one without writing them (the file is being cut
+     * back to its first blocks). None of them may be pinned.
+     * @param last the last block kept
+     */
+    virtual void discard(BlockID last);
+
+    /**
+     * change the number of frames. Cached blocks are flushed and dropped.
+     * @param num_frames how many blocks to keep in memory
+     */
+    virtual void resize(uint num_frames);
+
+    /**
+     * number of frames
+     */
+    virtual uint size(void) { return (uint) frames.size(); }
+
+    /**
+     * number of pins served from memory
+     */
+    virtual u_int64_t get_hits(void) { return hits; }
+
+    /**
+     * number of pins that had to read the file
+     */
+    virtual u_int64_t get_misses(void) { return misses; }
+
+protected:
+    /**
+     * one cached block and its bookkeeping
+     */
+    class Frame {
+    public:
+        char data[DbBlock::BLOCK_SZ]; // block memory
+        DbBlock *block; // block living in data, nullptr if the frame is free
+        uint pin_count; // outstanding pins
+        bool dirty; // modified since read
+        bool referenced; // CLOCK second-chance bit
+
+        Frame() : block(nullptr), pin_count(0), dirty(false), referenced(false) {}
+
+        // mark the frame free (the caller deletes the block)
+        void clear() {
+            block = nullptr;
+            pin_count = 0;
+            dirty = false;
+            referenced = false;
+        }
+    };
+
+    DbFile &file;
+    std::vector<Frame> frames;
+    std::unordered_map<BlockID, uint> page_table; // cached block id -> frame index
+    uint hand; // CLOCK hand
+    u_int64_t hits;
+    u_int64_t misses;
+
+    /**
+     * pick a frame to reuse, evicting (and writing back) its block.
+     * @return index of a free frame
+     * @throws DbBufferPoolFullError if every frame is pinned
+     */
+    virtual uint victim(void);
+
+    /**
+     * frame holding a pinned block
+     * @param block the block
+     * @return its frame
+     */
+    virtual Frame &frame_of(DbBlock *block);
+};
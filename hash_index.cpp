@@ -0,0 +1,402 @@
+/**
+ * @file hash_index.cpp - HashIndex implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "hash_index.h"
+
+/* -------------HashIndex::DbIndex-------------*/
+HashIndex::HashIndex(DbRelation &relation, Identifier name, ColumnNames key_columns)
+    : DbIndex(relation, name, key_columns), file(relation.get_table_name() + "-" + name), pool(file),
+      keys(relation, key_columns), global_depth(0) {}
+
+HashIndex::~HashIndex() {
+    if (file.is_open())
+        close();
+}
+
+void HashIndex::create() {
+    pool.discard();
+    file.create();
+    build();
+}
+
+void HashIndex::drop() {
+    pool.discard();
+    file.open(); // the file only knows its path once opened
+    file.drop();
+    std::remove(directory_path().c_str());
+}
+
+void HashIndex::open() {
+    if (file.is_open())
+        return;
+    file.open();
+    std::ifstream in(directory_path(), std::ios::binary);
+    u_int32_t header[3];
+    if (!in.read((char *) header, sizeof(header))) {
+        file.close();
+        throw DbRelationError("missing directory for index " + this->name);
+    }
+    if (header[2] == 0) {
+        // not closed: pages may have been rewritten by splits the saved directory doesn't know
+        in.close();
+        pool.discard();
+        file.close();
+        file.create();
+        build();
+        return;
+    }
+    this->global_depth = header[0];
+    this->directory.resize(1u << this->global_depth);
+    this->local_depths.resize(this->directory.size());
+    this->free_pages.resize(header[1]);
+    in.read((char *) this->directory.data(), this->directory.size() * sizeof(BlockID));
+    in.read((char *) this->local_depths.data(), this->local_depths.size());
+    in.read((char *) this->free_pages.data(), this->free_pages.size() * sizeof(BlockID));
+    if (!in) {
+        file.close();
+        throw DbRelationError("directory for index " + this->name + " is cut short");
+    }
+    in.close();
+    save_directory(false);
+}
+
+void HashIndex::close() {
+    // the pages go first, so a directory marked closed always matches them
+    pool.flush();
+    save_directory(true);
+    pool.discard();
+    file.close();
+}
+
+Handles *HashIndex::lookup(const ValueDict *key_values) {
+    std::string key = keys.encode(key_values);
+    u_int32_t h = hash(key);
+    std::string prefix = with_hash(h, key);
+    // the key's entries all start with this, and no other key's do
+    Handles *handles = new Handles();
+    BlockID page_id = this->directory[h & ((1u << this->global_depth) - 1)];
+    while (page_id != 0) {
+        BTreePage *page = pin(page_id);
+        for (RecordID i = page->lower_bound(prefix); i <= page->size(); i++) {
+            RecordView entry = page->key(i);
+            if (entry.size < prefix.size() || memcmp(entry.data, prefix.data(), prefix.size()) != 0)
+                break;
+            handles->push_back(IndexKey::handle(entry));
+        }
+        page_id = page->get_link();
+        pool.unpin(page);
+    }
+    return handles;
+}
+
+Handles *HashIndex::range(const ValueDict *min_key, const ValueDict *max_key) {
+    throw DbRelationError("hash index " + this->name + " can't look up ranges");
+}
+
+void HashIndex::check(const ValueDict *row) {
+    keys.check(row);
+}
+
+void HashIndex::insert(Handle handle) {
+    std::string key = keys.entry(handle);
+    if (key.empty())
+        return;
+    u_int32_t h = hash(key.substr(0, key.size() - IndexKey::HANDLE_SZ));
+    std::string entry = with_hash(h, key);
+    while (true) {
+        u_int32_t slot = h & ((1u << this->global_depth) - 1);
+        // look through the bucket for the entry and for room
+        BlockID page_id = this->directory[slot], room = 0, last = 0;
+        while (page_id != 0) {
+            BTreePage *page = pin(page_id);
+            RecordID i = page->lower_bound(entry);
+            if (i <= page->size()) {
+                RecordView found = page->key(i);
+                if (BTreePage::compare(found.data, found.size, entry.data(), entry.size()) == 0) {
+                    pool.unpin(page);
+                    return;
+                }
+            }
+            if (room == 0 && entry.size() <= page->get_free_space())
+                room = page_id;
+            last = page_id;
+            page_id = page->get_link();
+            pool.unpin(page);
+        }
+        if (room != 0) {
+            BTreePage *page = pin(room);
+            page->insert(entry);
+            pool.unpin(page, true);
+            return;
+        }
+        // full: split it if that could move some of its entries
+        bool others = false;
+        for (page_id = this->directory[slot]; page_id != 0 && !others; ) {
+            BTreePage *page = pin(page_id);
+            for (RecordID j = 1; j <= page->size() && !others; j++)
+                others = hash_of(page->key(j)) != h;
+            page_id = page->get_link();
+            pool.unpin(page);
+        }
+        if (others && this->local_depths[slot] < MAX_DEPTH) {
+            split(slot);
+            continue;
+        }
+        // all one key (or as deep as it goes): chain another page
+        BTreePage *page = take_page();
+        page->insert(entry);
+        BTreePage *tail = pin(last);
+        tail->set_link(page->get_block_id());
+        pool.unpin(tail, true);
+        pool.unpin(page, true);
+        return;
+    }
+}
+
+void HashIndex::del(Handle handle) {
+    std::string key = keys.entry(handle);
+    if (key.empty())
+        return;
+    u_int32_t h = hash(key.substr(0, key.size() - IndexKey::HANDLE_SZ));
+    std::string entry = with_hash(h, key);
+    BlockID page_id = this->directory[h & ((1u << this->global_depth) - 1)];
+    while (page_id != 0) {
+        BTreePage *page = pin(page_id);
+        RecordID i = page->lower_bound(entry);
+        if (i <= page->size()) {
+            RecordView found = page->key(i);
+            if (BTreePage::compare(found.data, found.size, entry.data(), entry.size()) == 0) {
+                page->del(i);
+                pool.unpin(page, true);
+                return;
+            }
+        }
+        page_id = page->get_link();
+        pool.unpin(page);
+    }
+    throw DbRelationError("row is not in index " + this->name);
+}
+
+// protected
+std::string HashIndex::directory_path(void) {
+    return file.home_path(relation.get_table_name() + "-" + this->name + ".dir");
+}
+
+void HashIndex::save_directory(bool closed) {
+    std::ofstream out(directory_path(), std::ios::binary | std::ios::trunc);
+    u_int32_t header[3] = {this->global_depth, (u_int32_t) this->free_pages.size(), closed ? 1u : 0u};
+    out.write((const char *) header, sizeof(header));
+    out.write((const char *) this->directory.data(), this->directory.size() * sizeof(BlockID));
+    out.write((const char *) this->local_depths.data(), this->local_depths.size());
+    out.write((const char *) this->free_pages.data(), this->free_pages.size() * sizeof(BlockID));
+}
+
+u_int32_t HashIndex::hash(const std::string &key) {
+    u_int32_t h = 2166136261u;
+    for (unsigned char c: key) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+std::string HashIndex::with_hash(u_int32_t h, const std::string &bytes) {
+    std::string entry(HASH_SZ, '\0');
+    for (int i = 0; i < HASH_SZ; i++)
+        entry[i] = (char) (h >> (24 - 8 * i));
+    return entry + bytes;
+}
+
+u_int32_t HashIndex::hash_of(const RecordView &entry) {
+    const unsigned char *h = (const unsigned char *) entry.data;
+    return ((u_int32_t) h[0] << 24) | ((u_int32_t) h[1] << 16) | ((u_int32_t) h[2] << 8) | h[3];
+}
+
+void HashIndex::grow_directory(void) {
+    uint size = this->directory.size();
+    this->directory.resize(2 * size);
+    this->local_depths.resize(2 * size);
+    std::copy(this->directory.begin(), this->directory.begin() + size, this->directory.begin() + size);
+    std::copy(this->local_depths.begin(), this->local_depths.begin() + size, this->local_depths.begin() + size);
+    this->global_depth++;
+}
+
+void HashIndex::split(u_int32_t slot) {
+    uint depth = this->local_depths[slot];
+    if (depth == this->global_depth)
+        grow_directory();
+    // take the bucket's entries out, freeing its pages
+    u_int32_t bit = 1u << depth;
+    std::vector<std::string> low, high;
+    size_t freed = this->free_pages.size();
+    BlockID page_id = this->directory[slot];
+    while (page_id != 0) {
+        BTreePage *page = pin(page_id);
+        for (RecordID i = 1; i <= page->size(); i++) {
+            RecordView entry = page->key(i);
+            (hash_of(entry) & bit ? high : low).push_back(std::string(entry.data, entry.size));
+        }
+        this->free_pages.push_back(page_id);
+        page_id = page->get_link();
+        pool.unpin(page);
+    }
+    // handed out again in the same order, so the low half keeps the bucket's first page
+    std::reverse(this->free_pages.begin() + freed, this->free_pages.end());
+    std::sort(low.begin(), low.end());
+    std::sort(high.begin(), high.end());
+    BlockID low_head = write_chain(low);
+    BlockID high_head = write_chain(high);
+    for (u_int32_t i = slot & (bit - 1); i < this->directory.size(); i += bit) {
+        this->directory[i] = i & bit ? high_head : low_head;
+        this->local_depths[i] = depth + 1;
+    }
+}
+
+void HashIndex::build(void) {
+    // one bucket to start with: block 1, made by create
+    this->global_depth = 0;
+    this->directory.assign(1, 1);
+    this->local_depths.assign(1, 0);
+    this->free_pages.clear();
+    DbRelationCursor *cursor = relation.scan();
+    Handle handle;
+    try {
+        while (cursor->next(handle))
+            insert(handle);
+    } catch (...) {
+        delete cursor;
+        throw;
+    }
+    delete cursor;
+    save_directory(false);
+}
+
+BTreePage *HashIndex::take_page(void) {
+    if (this->free_pages.empty())
+        return (BTreePage *) pool.pin_new();
+    BTreePage *page = pin(this->free_pages.back());
+    this->free_pages.pop_back();
+    page->clear();
+    page->set_link(0);
+    return page;
+}
+
+BlockID HashIndex::write_chain(const std::vector<std::string> &entries) {
+    BTreePage *page = take_page();
+    BlockID head = page->get_block_id();
+    for (auto const& entry: entries) {
+        if (entry.size() > page->get_free_space()) {
+            BTreePage *next = take_page();
+            page->set_link(next->get_block_id());
+            pool.unpin(page, true);
+            page = next;
+        }
+        page->insert(entry);
+    }
+    pool.unpin(page, true);
+    return head;
+}
+
+/*
+ * Index test: enough rows for buckets to split and the directory to double, and a popular
+ * key whose bucket can only overflow
+ */
+bool test_hash_index() {
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    ColumnAttribute ca(ColumnAttribute::INT);
+    column_attributes.push_back(ca);
+    ca.set_data_type(ColumnAttribute::TEXT);
+    column_attributes.push_back(ca);
+    HeapTable table("_test_hash_cpp", column_names, column_attributes);
+    table.create();
+    ColumnNames key_columns;
+    key_columns.push_back("a");
+    HashIndex index(table, "fxx", key_columns);
+    key_columns[0] = "b";
+    HashIndex popular(table, "fyy", key_columns);
+    Handles handles;
+    for (int32_t i = 0; i < 5000; i++) {
+        if (i == 1000) {
+            index.create();
+            table.add_index(&index);
+            popular.create();
+            table.add_index(&popular);
+        }
+        ValueDict row;
+        row["a"] = Value(i);
+        row["b"] = Value(i % 2 == 0 ? "even" : "b" + std::to_string(i));
+        handles.push_back(table.insert(&row));
+    }
+    index.close();
+    index.open();
+    bool ok = true;
+    for (int32_t i = 0; i < 5000 && ok; i++) {
+        ValueDict key;
+        key["a"] = Value(i);
+        Handles *found = index.lookup(&key);
+        ok = found->size() == 1 && (*found)[0] == handles[i];
+        delete found;
+    }
+    if (!ok)
+        return false;
+    std::cout << "hash lookup ok" << std::endl;
+    ValueDict key;
+    key["b"] = Value("even");
+    Handles *found = popular.lookup(&key);
+    ok = found->size() == 2500;
+    delete found;
+    // = goes through the index, a range can't and scans instead
+    Predicates where = {Predicate("b", Predicate::EQ, Value("even")), Predicate("a", Predicate::LT, Value(10))};
+    found = table.select(&where);
+    ok = ok && found->size() == 5;
+    delete found;
+    where = {Predicate("a", Predicate::GE, Value(4990))};
+    found = table.select(&where);
+    ok = ok && found->size() == 10;
+    delete found;
+    try {
+        delete index.range(&key, &key);
+        ok = false;
+    } catch (DbRelationError &e) {
+    }
+    if (!ok)
+        return false;
+    std::cout << "hash overflow ok" << std::endl;
+    // deletes and key changes take their entries with them: half the even rows go, as many odd ones join them
+    for (int32_t i = 0; i < 5000; i += 4) {
+        table.del(handles[i]);
+        ValueDict change;
+        change["b"] = Value("even");
+        table.update(handles[i + 1], &change);
+    }
+    found = popular.lookup(&key);
+    ok = found->size() == 2500;
+    delete found;
+    for (int32_t i = 0; i < 5000 && ok; i++) {
+        ValueDict a_key;
+        a_key["a"] = Value(i);
+        found = index.lookup(&a_key);
+        ok = i % 4 == 0 ? found->empty() : found->size() == 1 && (*found)[0] == handles[i];
+        delete found;
+    }
+    if (!ok)
+        return false;
+    std::cout << "hash del ok" << std::endl;
+    table.remove_index(&index);
+    table.remove_index(&popular);
+    index.drop();
+    popular.drop();
+    table.drop();
+    return true;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file hash_index.h - Extendible hashing implementation of DbIndex.
+ * HashIndex: DbIndex
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include "btree.h"
+
+/**
+ * @class HashIndex - extendible hash index on one or more INT/TEXT columns, for equality lookups
+ *
+ *      Kept in its own file, <table>-<index>.db. A bucket is a chain of BTreePages (link is the
+        next page) holding IndexKey entries prefixed by their key's 4-byte hash. The directory,
+        2^global_depth bucket heads picked by the low bits of the hash, lives in memory and is
+        saved next to the file as <table>-<index>.dir, with each bucket's local depth and the
+        pages splits have freed. Splits rewrite pages the saved directory may still point to, so
+        the saved directory is only trusted if the index was closed: open() marks it in use, and
+        finding it still marked rebuilds the index from the table.
+        When a bucket fills up only that bucket is split, doubling the directory first if its
+        local depth has caught up with the global one, so the table is never rehashed all at once.
+        A bucket whose entries all share one hash (a popular key) gets overflow pages instead.
+        A lookup reads the bucket's one page (more only for very popular keys), however big the
+        table is. From Fagin et al., "Extendible Hashing" (TODS 1979).
+ */
+class HashIndex : public DbIndex {
+public:
+    static const uint MAX_DEPTH = 20; // directory of at most 2^20 buckets
+    static const u_int16_t HASH_SZ = sizeof(u_int32_t);
+
+    /**
+     * @param relation the indexed table
+     * @param name index name
+     * @param key_columns columns of the key, in order
+     * @throws DbRelationError for an unknown column
+     */
+    HashIndex(DbRelation &relation, Identifier name, ColumnNames key_columns);
+
+    virtual ~HashIndex();
+
+    HashIndex(const HashIndex &other) = delete;
+
+    HashIndex &operator=(const HashIndex &other) = delete;
+
+    virtual void create();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual Handles *lookup(const ValueDict *key_values);
+
+    /**
+     * @throws DbRelationError always: hashing keeps no order
+     */
+    virtual Handles *range(const ValueDict *min_key, const ValueDict *max_key);
+
+    virtual void insert(Handle handle);
+
+    virtual void check(const ValueDict *row);
+
+    virtual void del(Handle handle);
+
+    virtual bool is_ordered() const { return false; }
+
+protected:
+    BTreeFile file;
+    BufferPool pool; // the index's bucket pages
+    IndexKey keys;
+    uint global_depth;
+    std::vector<BlockID> directory; // first page of each bucket, by the low global_depth bits of the hash
+    std::vector<u_int8_t> local_depths; // of the bucket each directory entry points to
+    std::vector<BlockID> free_pages; // emptied by splits, for the next chains to use
+
+    /**
+     * where the directory is saved
+     */
+    std::string directory_path(void);
+
+    /**
+     * write the directory out
+     * @param closed whether the pages are all written and match it (else it is marked in use)
+     */
+    void save_directory(bool closed);
+
+    /**
+     * start the index over from the table's rows
+     */
+    void build(void);
+
+    /**
+     * FNV-1a hash of an encoded key
+     */
+    static u_int32_t hash(const std::string &key);
+
+    /**
+     * bytes prefixed by a hash (big-endian), as stored in the buckets
+     */
+    static std::string with_hash(u_int32_t h, const std::string &bytes);
+
+    /**
+     * the hash a stored entry starts with
+     */
+    static u_int32_t hash_of(const RecordView &entry);
+
+    BTreePage *pin(BlockID block_id) { return (BTreePage *) pool.pin(block_id); }
+
+    /**
+     * double the directory: each new entry points where its twin (without the top bit) does
+     */
+    void grow_directory(void);
+
+    /**
+     * split the bucket at a directory entry in two on the next bit of the hash, rewriting its
+     * pages and repointing the directory entries of the half that moves
+     * @param slot any directory entry pointing to the bucket
+     */
+    void split(u_int32_t slot);
+
+    /**
+     * an empty page for a chain: a free one if there is one, else a new one
+     * @return the page, pinned
+     */
+    BTreePage *take_page(void);
+
+    /**
+     * lay entries out in a new chain of pages
+     * @param entries the entries, sorted
+     * @return the chain's first page
+     */
+    BlockID write_chain(const std::vector<std::string> &entries);
+};
+
+/**
+ * Index test (run by the shell's "test" command)
+ */
+bool test_hash_index();
@@ -13,10 +13,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include<cstring>
+#include <map>
+#include <random>
+#include <unordered_map>
 
 // comes with milestone 1 starter files
 #include "db_cxx.h"
 #include "storage_engine.h"
+#include "buffer_pool.h"
+#include "row_codec.h"
+#include "pax_page.h"
+#include "snapshot.h"
+#include "work_pool.h"
+#include "vacuum.h"
 
 using namespace std;
 extern DbEnv *_DB_ENV;
@@ -29,11 +38,17 @@ extern DbEnv *_DB_ENV;
 
         Record id are handed out sequentially starting with 1 as records are added with add().
         Each record has a header which is a fixed offset from the beginning of the block:
-            Bytes 0x00 - Ox01: number of records
+            Bytes 0x00 - Ox01: number of records (slots handed out, including deleted ones)
             Bytes 0x02 - 0x03: offset to end of free space
-            Bytes 0x04 - 0x05: size of record 1
-            Bytes 0x06 - 0x07: offset to record 1
+            Bytes 0x04 - 0x05: number of fragmented bytes (left behind by del/put, not yet compacted)
+            Bytes 0x06 - 0x07: first deleted record id available for reuse (0 if none)
+            Bytes 0x08 - 0x09: size of record 1
+            Bytes 0x0A - 0x0B: offset to record 1
             etc.
+
+        Deleting a record only leaves a tombstone: its header gets offset 0 and its size field
+        links to the next reusable record id. The freed bytes are counted as fragmented and are
+        only reclaimed, in a single compaction pass, once add() or put() actually needs the room.
  *
  */
 class SlottedPage : public DbBlock {
@@ -77,6 +92,14 @@ public:
      */
     virtual Dbt *get(RecordID record_id);
 
+    /**
+     * get a borrowed view of a record's data for a given record id. Unlike get(),
+     * nothing is allocated or copied; the view points into this page's block.
+     * @param record_id corresponding record id
+     * @return pointer and size of the record, valid while this page is held
+     */
+    virtual RecordView view(RecordID record_id);
+
     /**
      * updates the record's data or, for some file organizations
      * like add, but where we already know the record id.
@@ -93,14 +116,47 @@ public:
     virtual void del(RecordID record_id);
 
     /**
-    * iterate through all the record ids in this block.
+    * iterate through all the record ids in this block (deleted ones are skipped).
     * @return an array of all records' id
     */
     virtual RecordIDs *ids(void);
 
+    /**
+    * step to the next live record id, skipping deleted ones.
+    * @param record_id the current record id (0 for the first)
+    * @return the next record id, 0 when there are no more
+    */
+    virtual RecordID next_id(RecordID record_id = 0);
+
+    /**
+    * how many bytes a new record could take, counting fragmented space and the header it needs.
+    * @return free bytes for record data
+    */
+    virtual u_int16_t get_free_space(void);
+
+    /**
+     * squeeze out all fragmented space in one pass, packing live records against the end
+     * of the block and rewriting their headers. Deleted record ids stay reusable.
+     * @return false if there was no fragmented space
+     */
+    virtual bool compact();
+
+    static const u_int16_t HEADER_SZ = 8; // size of the block header before record 1's header
+    static const u_int16_t MAX_RECORD_SZ = DbBlock::BLOCK_SZ - HEADER_SZ - 4; // fills an empty block
+
 protected:
+
     u_int16_t num_records; // the number of records
     u_int16_t end_free; // address of the last free byte
+    u_int16_t fragmented; // bytes held by deleted or shrunk records, reclaimed by compact()
+    u_int16_t free_id; // head of the list of deleted record ids to reuse
+
+    /**
+    * Offset of the header for given id. For id of zero, it is the block header.
+    * @param id record id
+    * @return offset from the first byte in the block
+    */
+    virtual u_int16_t header_offset(RecordID id);
 
     /**
     * Get the size and offset for given id. For id of zero, it is the block header. The opposite of put()
@@ -119,19 +175,19 @@ protected:
     virtual void put_header(RecordID id = 0, u_int16_t size = 0, u_int16_t loc = 0);
 
     /**
-    * has enough extra room to store data
-    * @param size of data, number of recordrs
-    * @return if there is equal or more than number of "size" records available in the current block
+    * has enough extra room to store data, counting fragmented bytes compact() would give back
+    * @param size of data, number of bytes
+    * @param new_id whether a new record header is needed too (no deleted id to reuse)
+    * @return if there is equal or more than "size" bytes available in the current block
     */
-    virtual bool has_room(u_int16_t size);
+    virtual bool has_room(u_int16_t size, bool new_id = false);
 
     /**
-     * slide a record in the block, and thus slide free space and all records on its left
-     * p.s. locationi of a data record means location of the first byte of the record
-     * @param start location of data record before sliding
-     * @param end location of data record after sliding
-     */
-    virtual void slide(u_int16_t start, u_int16_t end);
+    * contiguous bytes between the last record header and the start of the records
+    * @param new_id whether to leave space for one more record header
+    * @return number of bytes that can be handed out without compacting
+    */
+    virtual u_int16_t contiguous_free(bool new_id = false);
 
     /**
      * get data given the offset
@@ -155,13 +211,453 @@ protected:
     virtual void *address(u_int16_t offset);
 };
 
+/**
+ * @class FreeSpaceMap - how full each block of a HeapFile is.
+ *
+ *      One byte per block holding its free space in units of FREE_UNIT bytes (rounded down, so
+        a block is never thought to have more room than it does). Kept next to the heap file as
+        <name>.fsm and loaded/saved with it. Each fill level also keeps a bucket of the blocks at
+        that level, so find() checks at most MAX_LEVEL buckets however many blocks there are and
+        however few of them have room. The block last handed out is tried first, so steady inserts
+        keep hitting the same block.
+ */
+class FreeSpaceMap {
+public:
+    static const u_int16_t FREE_UNIT = 16; // bytes of free space per level
+    static const u_int16_t MAX_LEVEL = 255; // levels fit in one byte
+
+    FreeSpaceMap() : buckets(MAX_LEVEL + 1), hint(0) { clear(); }
+
+    virtual ~FreeSpaceMap() {}
+
+    /**
+     * forget all blocks (e.g. the file was truncated)
+     */
+    virtual void clear(void);
+
+    /**
+     * read the map saved by save()
+     * @param path file to read
+     * @return false if there is no saved map
+     */
+    virtual bool load(const std::string &path);
+
+    /**
+     * write the map out
+     * @param path file to write
+     */
+    virtual void save(const std::string &path);
+
+    /**
+     * record how much room a block has, growing the map if it is a new block
+     * @param block_id which block
+     * @param free_space free bytes in the block (DbBlock::get_free_space())
+     */
+    virtual void update(BlockID block_id, u_int16_t free_space);
+
+    /**
+     * find a block with at least size bytes free
+     * @param size bytes needed
+     * @return the block's id, or 0 if no block has enough room
+     */
+    virtual BlockID find(u_int16_t size);
+
+    /**
+     * find the first block before a given one with at least size bytes free
+     * (for moving records towards the front of the file)
+     * @param size bytes needed
+     * @param limit blocks from this one on aren't considered
+     * @return the block's id, or 0 if none of them has enough room
+     */
+    virtual BlockID find_before(u_int16_t size, BlockID limit);
+
+    /**
+     * forget the blocks after the first few (the file was cut back to them)
+     * @param blocks how many blocks are left
+     */
+    virtual void truncate(u_int32_t blocks);
+
+    /**
+     * number of blocks in the map
+     */
+    virtual u_int32_t size(void) { return (u_int32_t) levels.size(); }
+
+protected:
+    std::vector<u_int8_t> levels; // fill level of block i + 1
+    std::vector<std::vector<u_int32_t> > buckets; // indexes of the blocks at each level, in no order
+    std::vector<u_int32_t> places; // where index i is in its bucket
+    u_int32_t hint; // index where the last search succeeded
+
+    /**
+     * fill level for a number of free bytes
+     */
+    static u_int8_t level(u_int16_t free_space);
+
+    /**
+     * put block index i into the bucket for level l / take it out of its bucket
+     */
+    void bucket_add(u_int32_t i, u_int8_t l);
+
+    void bucket_remove(u_int32_t i);
+};
+
+/**
+ * @class ZoneMap - the smallest and largest value of every column in each block of a HeapTable.
+ *
+ *      Kept next to the table as <name>.zone and loaded/saved with it. Bounds are widened as rows
+        go in; a delete leaves them looser than the rows left until vacuum compacts the block and
+        works them out again from what is left. Values are compared as 64-bit keys in the same
+        order as the values: an INT exactly, a TEXT by its first PREFIX_SZ bytes. A scan with
+        predicates skips a block when the bounds show that no row in it can match, e.g. a > 1000000 in a block whose a values top out at 5000.
+ */
+class ZoneMap {
+public:
+    static const u_int16_t PREFIX_SZ = 8; // bytes of a TEXT value in its key
+
+    /**
+     * @param layout the table's record format (must outlive the map)
+     */
+    ZoneMap(const RowLayout &layout) : layout(layout) {}
+
+    virtual ~ZoneMap() {}
+
+    /**
+     * forget all blocks
+     */
+    virtual void clear(void) { bounds.clear(); }
+
+    /**
+     * read the map saved by save()
+     * @param path file to read
+     * @return false if there is no saved map
+     */
+    virtual bool load(const std::string &path);
+
+    /**
+     * write the map out
+     * @param path file to write
+     */
+    virtual void save(const std::string &path);
+
+    /**
+     * make sure the map covers this many blocks (the new ones holding no rows yet)
+     */
+    virtual void grow(u_int32_t blocks);
+
+    /**
+     * forget the blocks after the first few (the file was cut back to them)
+     */
+    virtual void truncate(u_int32_t blocks);
+
+    /**
+     * start a block's bounds over, as if it held no rows (to widen them again from the rows left)
+     */
+    virtual void reset(BlockID block_id);
+
+    /**
+     * widen a block's bounds to take in a record
+     * @param block_id the block it went into
+     * @param record the record (RowLayout format)
+     */
+    virtual void widen(BlockID block_id, const RecordView &record);
+
+    /**
+     * can a comparison hold for some row of a block?
+     * @param block_id which block
+     * @param column which column
+     * @param op the comparison
+     * @param key the value compared with, as int_key() or text_key()
+     * @return false only if no non-null value within the block's bounds could satisfy it
+     */
+    virtual bool may_hold(BlockID block_id, uint column, Predicate::Op op, u_int64_t key) const;
+
+    /**
+     * number of blocks in the map
+     */
+    virtual u_int32_t size(void) const;
+
+    static u_int64_t int_key(int32_t n) { return (u_int64_t) ((u_int32_t) n ^ 0x80000000u); }
+
+    static u_int64_t text_key(const char *s, size_t size);
+
+protected:
+    const RowLayout &layout;
+    std::vector<u_int64_t> bounds; // per block, per column: min key, max key (min > max while all null)
+};
+
+/**
+ * @class BloomFilters - a Bloom filter of each block's values for some columns of a HeapTable.
+ *
+ *      For an = predicate on a column with many distinct values and no index, a block's zone
+        map bounds almost always straddle the value; its Bloom filter can still say the value is
+        not in the block, so the scan skips reading it. Each filter is FILTER_BITS bits set by
+        NUM_HASHES probes (double hashing of a 64-bit hash of the value's bytes); with a block's
+        worth of small rows that lets through about one block in a hundred. Kept next to the
+        table as <name>.bloom, added to as rows go in, worked out again from the records when
+        missing or out of date.
+ */
+class BloomFilters {
+public:
+    static const uint FILTER_BITS = 2048; // 256 bytes a block per column
+    static const uint NUM_HASHES = 4;
+
+    /**
+     * @param layout the table's record format (must outlive the filters)
+     * @param columns the columns to keep filters for
+     */
+    BloomFilters(const RowLayout &layout, const std::vector<uint> &columns);
+
+    virtual ~BloomFilters() {}
+
+    /**
+     * whether any column has filters
+     */
+    virtual bool empty(void) const { return columns.empty(); }
+
+    /**
+     * forget all blocks
+     */
+    virtual void clear(void) { bits.clear(); }
+
+    /**
+     * read the filters saved by save()
+     * @param path file to read
+     * @return false if there are no saved filters
+     */
+    virtual bool load(const std::string &path);
+
+    /**
+     * write the filters out
+     * @param path file to write
+     */
+    virtual void save(const std::string &path);
+
+    /**
+     * make sure there are filters for this many blocks (the new ones empty)
+     */
+    virtual void grow(u_int32_t blocks);
+
+    /**
+     * forget the blocks after the first few (the file was cut back to them)
+     */
+    virtual void truncate(u_int32_t blocks);
+
+    /**
+     * empty a block's filters (to add the rows left again)
+     */
+    virtual void reset(BlockID block_id);
+
+    /**
+     * add a record's values to its block's filters
+     * @param block_id the block it went into
+     * @param record the record (RowLayout format)
+     */
+    virtual void add(BlockID block_id, const RecordView &record);
+
+    /**
+     * could a block hold a value in a column?
+     * @param block_id which block
+     * @param column which column
+     * @param hash the value's hash()
+     * @return false only if the value is certainly not in the block (or the column has no filter: true)
+     */
+    virtual bool may_contain(BlockID block_id, uint column, u_int64_t hash) const;
+
+    /**
+     * number of blocks with filters
+     */
+    virtual u_int32_t size(void) const;
+
+    /**
+     * hash of a value's bytes (an INT's are its 4 bytes in memory order)
+     */
+    static u_int64_t hash(const char *bytes, size_t size);
+
+protected:
+    static const uint WORDS = FILTER_BITS / 64; // per filter
+
+    const RowLayout &layout;
+    std::vector<uint> columns; // with filters
+    std::vector<int> filter_of; // by column number: its place in columns, -1 if none
+    std::vector<u_int64_t> bits; // per block, per filtered column: WORDS words
+
+    /**
+     * the filter for a block's column
+     */
+    u_int64_t *filter(BlockID block_id, uint i) { return bits.data() + ((block_id - 1) * columns.size() + i) * WORDS; }
+};
+
+/**
+ * @class VersionStore - old versions of a HeapTable's rows, kept while a snapshot might read them
+ *
+ *      Updates rewrite a row where it is, so the version an older snapshot should see is copied
+        here first, by handle, stamped with when it was replaced. Copies are only made while some
+        snapshot is older than the write, and are dropped once none is. Kept in memory only:
+        snapshots don't outlive the process.
+ */
+class VersionStore {
+public:
+    /**
+     * @param layout the table's record format (must outlive the store)
+     */
+    explicit VersionStore(const RowLayout &layout) : layout(layout) {}
+
+    virtual ~VersionStore() {}
+
+    virtual bool empty(void) const { return versions.empty(); }
+
+    /**
+     * keep a copy of a row's version before it is replaced
+     * @param handle the row
+     * @param record the version, with its deleted stamp set to when it was replaced
+     */
+    virtual void keep(Handle handle, const RecordView &record);
+
+    /**
+     * the version of a row a snapshot sees
+     * @param handle the row
+     * @param snapshot the reader's snapshot
+     * @param record the row's record as stored now; set to the version the snapshot sees
+     *        (borrowed from the store until the next prune()) if that is an older one
+     * @return false if the snapshot sees no version of the row
+     */
+    virtual bool see(Handle handle, const Snapshot &snapshot, RecordView &record) const;
+
+    /**
+     * drop the versions replaced before a timestamp
+     * @param oldest the oldest snapshot in use (VersionClock::oldest)
+     */
+    virtual void prune(Timestamp oldest);
+
+protected:
+    const RowLayout &layout;
+    std::map<Handle, std::vector<std::string>> versions; // of each row, oldest first
+};
+
+/**
+ * @class ColumnStats - what ANALYZE found out about one column of a table
+ */
+class ColumnStats {
+public:
+    double null_frac; // fraction of the rows with a null here
+    u_int64_t ndv; // estimated number of distinct non-null values
+    bool has_range; // whether min and max are set (not when every value is null)
+    Value min, max;
+    std::vector<int32_t> histogram; // INT only: equi-depth bucket bounds from min to max (empty if none)
+
+    ColumnStats() : null_frac(0), ndv(0), has_range(false) {}
+
+    /**
+     * estimated fraction of the non-null values that are <= n, from the histogram
+     * (interpolating within a bucket)
+     */
+    virtual double fraction_at_most(int32_t n) const;
+};
+
+/**
+ * @class TableStats - ANALYZE's statistics for a table, one ColumnStats per column
+ */
+class TableStats {
+public:
+    u_int64_t row_count; // estimated number of rows
+    std::vector<ColumnStats> columns; // in column order
+
+    TableStats() : row_count(0) {}
+};
+
+/**
+ * @class StatsBuilder - TableStats from a sample of a table's records
+ *
+ *      ANALYZE feeds it every row of a random sample of blocks and scales what it saw up to the
+        whole table. The number of distinct values is estimated from how many values the sample
+        saw once and how many it saw at all (Haas and Stokes' Duj1 estimator), and INT columns
+        get an equi-depth histogram of the sampled values.
+        A HeapTable with statistics also feeds its inserts to one, and folds them into the
+        statistics (merge_into) once they add up to STALE_FRACTION of the table, so statistics
+        follow the table without another ANALYZE.
+ */
+class StatsBuilder {
+public:
+    static const uint HISTOGRAM_BUCKETS = 16;
+    static const uint MAX_VALUES = 1 << 15; // INT values kept per column for the histogram (a random sample past that)
+    static const uint MAX_DISTINCT = 1 << 16; // distinct values counted per column, the rest only as "seen"
+    static const u_int64_t MIN_STALE_ROWS = 1000; // inserts that always make statistics stale
+    static constexpr double STALE_FRACTION = 0.1; // or this fraction of the table's rows, if more
+
+    /**
+     * @param layout the table's record format (must outlive the builder)
+     * @param base the statistics the records will be folded into, if any (must outlive the builder)
+     */
+    StatsBuilder(const RowLayout &layout, const TableStats *base = nullptr);
+
+    virtual ~StatsBuilder() {}
+
+    /**
+     * take in one row
+     */
+    virtual void add(const RecordView &record);
+
+    /**
+     * number of rows taken in
+     */
+    virtual u_int64_t size(void) const { return rows; }
+
+    /**
+     * statistics of the table the rows were sampled from
+     * @param total_rows (estimated) rows in the table, at least size()
+     */
+    virtual TableStats build(u_int64_t total_rows) const;
+
+    /**
+     * fold the rows taken in (inserted since base was built) into base
+     * @param deleted rows deleted since then
+     */
+    virtual void merge_into(TableStats &base, u_int64_t deleted) const;
+
+    /**
+     * have enough rows come in since base was built that it should be brought up to date?
+     */
+    virtual bool is_stale(u_int64_t deleted) const;
+
+protected:
+    struct Column {
+        u_int64_t nulls;
+        std::unordered_map<u_int64_t, u_int32_t> counts; // times each value (by hash) was seen
+        u_int64_t untracked; // values seen once counts was full
+        u_int64_t outside; // values outside base's range
+        bool has_range;
+        Value min, max;
+        std::vector<int32_t> values; // INT values, for the histogram
+        u_int64_t ints; // INT values seen, of which values holds a random sample
+
+        Column() : nulls(0), untracked(0), outside(0), has_range(false), ints(0) {}
+    };
+
+    const RowLayout &layout;
+    const TableStats *base;
+    u_int64_t rows;
+    std::vector<Column> columns;
+    std::mt19937 random; // for the reservoir sample of values
+
+    /**
+     * distinct non-null values in the table, from the sample's counts
+     */
+    virtual u_int64_t estimate_ndv(const Column &column, u_int64_t table_values) const;
+
+    /**
+     * equi-depth bucket bounds of sorted values
+     */
+    static std::vector<int32_t> histogram(const std::vector<int32_t> &sorted);
+};
+
 /**
  * @class HeapFile - heap file implementation of DbFile
  *
  * Heap file organization. Built on top of Berkeley DB RecNo file. There is one of our
         database blocks for each Berkeley DB record in the RecNo file. In this way we are using Berkeley DB
         for buffer management and file management.
-        Uses SlottedPage for storing records within blocks.
+        Uses SlottedPage (or PaxPage, see set_pax_layout) for storing records within blocks,
+        and a FreeSpaceMap to track which of them still have room.
  */
 class HeapFile : public DbFile {
 public:
@@ -169,7 +665,8 @@ public:
      * constructor
      * @param name of the db file
      */
-    HeapFile(std::string name) : DbFile(name), dbfilename(""), last(0), closed(true), db(_DB_ENV, 0) {}
+    HeapFile(std::string name)
+        : DbFile(name), dbfilename(""), last(0), closed(true), db(_DB_ENV, 0), pax_layout(nullptr) {}
 
     // not implemented
     virtual ~HeapFile() {}
@@ -205,11 +702,28 @@ public:
      */
     virtual void close(void);
 
+    /**
+     * whether the file is already there (so it can be opened rather than created)
+     */
+    virtual bool exists(void);
+
+    /**
+     * make everything put() so far durable: flush Berkeley DB's cache and save the free-space map.
+     */
+    virtual void sync(void);
+
     /**
      * create a new empty block and add it to the database file.
      * @return a new block to be modified by the client via the DbBlock interface.
      */
-    virtual SlottedPage *get_new(void);
+    virtual DbBlock *get_new(void);
+
+    /**
+     * like get_new(), but the new block lives in the caller's memory.
+     * @param buffer DbBlock::BLOCK_SZ bytes that will hold the block
+     * @return a new block to be modified by the client via the DbBlock interface.
+     */
+    virtual DbBlock *get_new(char *buffer);
 
     /**
      * get a block from the database file (via the buffer manager, presumably) for a given block id.
@@ -217,7 +731,16 @@ public:
      * @param block_id  which block to get
      * @returns pointer to the DbBlock (freed by caller)
      */
-    virtual SlottedPage *get(BlockID block_id);
+    virtual DbBlock *get(BlockID block_id);
+
+    /**
+     * like get(), but the block is read into the caller's memory instead of Berkeley DB's,
+     * so it stays valid across other calls on this file.
+     * @param block_id  which block to get
+     * @param buffer    DbBlock::BLOCK_SZ bytes that will hold the block
+     * @returns pointer to the DbBlock (freed by caller)
+     */
+    virtual DbBlock *get(BlockID block_id, char *buffer);
 
     /**
      * write a block to the file. Presumably the client has made modifications in the block that
@@ -227,22 +750,104 @@ public:
      */
     virtual void put(DbBlock *block);
 
+    /**
+     * append a block that was built in memory (e.g. by a bulk load) with one write.
+     * @param block a new block whose id is get_last_block_id() + 1; it becomes the last block
+     */
+    virtual void put_new(DbBlock *block);
+
+    /**
+     * give back the blocks at the end of the file: the ones after last are deleted and
+     * last becomes the last block. The caller makes sure nothing in them is still wanted.
+     * @param last the last block kept (at least 1)
+     */
+    virtual void truncate(BlockID last);
+
+    /**
+     * read-ahead for sequential scans: fetch up to count consecutive blocks starting at first
+     * with one bulk Berkeley DB cursor read (DB_MULTIPLE_KEY) instead of a get per block.
+     * The blocks point into bulk, so they are only valid until bulk is reused.
+     * @param first first block id wanted
+     * @param count most blocks to read
+     * @param bulk buffer for the bulk read (grown as needed, reused across calls)
+     * @param blocks gets the blocks that were read, in block id order (freed by caller)
+     */
+    virtual void get_many(BlockID first, uint count, std::vector<char> &bulk, std::vector<DbBlock *> &blocks);
+
     /** iterate through all the block ids in the file.
      * @return  @returns  a pointer to vector of BlockIDs (freed by caller), includes deleted blocks)
      */
     virtual BlockIDs *block_ids();
 
+    /** the block ids in the file as a range, without building a vector.
+     * @return blocks 1 through last
+     */
+    virtual BlockIDRange blocks() { return BlockIDRange(1, last); }
+
     /**
      * get the last block's id
      * @return the last block's id
      */
     virtual u_int32_t get_last_block_id() { return last; }
 
+    /**
+     * whether the file is currently open
+     */
+    virtual bool is_open() { return !closed; }
+
+    /**
+     * pick a block that can take a new record of the given size, using the free-space map.
+     * @param size size of the marshaled record
+     * @return the block's id, or 0 if every block is too full (caller should get_new())
+     */
+    virtual BlockID find_free_block(u_int16_t size);
+
+    /**
+     * like find_free_block(size), but only the blocks before a given one are considered,
+     * the first of them with room being picked (for moving records towards the front).
+     * @param size size of the marshaled record
+     * @param before the blocks from this one on are left out
+     * @return the block's id, or 0 if none of them has room
+     */
+    virtual BlockID find_free_block(u_int16_t size, BlockID before);
+
+    /**
+     * note a block's current free space in the free-space map without writing the block
+     * (for blocks modified in the buffer pool; put() does this on its own).
+     * @param block the modified block
+     */
+    virtual void update_free_space(DbBlock *block);
+
+    /**
+     * store rows column by column: blocks become PaxPages for this record format
+     * instead of SlottedPages. Has to be set before the file is opened or created.
+     * @param layout the table's record format (must outlive the file), nullptr for SlottedPage
+     */
+    virtual void set_pax_layout(const RowLayout *layout) { pax_layout = layout; }
+
+    /**
+     * wrap block memory in this file's kind of block
+     * @param data the block's memory
+     * @param block_id its id
+     * @param is_new whether to format it as an empty block
+     * @return the block (freed by caller)
+     */
+    virtual DbBlock *make_block(Dbt &data, BlockID block_id, bool is_new);
+
+    /**
+     * full path of a file that lives next to this one in the database environment
+     * @param filename name of the file within the environment's home directory
+     * @return the path
+     */
+    virtual std::string home_path(const std::string &filename);
+
 protected:
     std::string dbfilename; // db file name
     u_int32_t last; // last block's id
     bool closed; // db file is close or not(can't open a closed file)
     Db db; // db's physical environment
+    FreeSpaceMap fsm; // free space of each block, saved in <name>.fsm
+    const RowLayout *pax_layout; // record format for PaxPage blocks, nullptr for SlottedPage
 
     /** Wrapper for Berkeley DB open, which does both open and creation.
      * @param flags flag for the DbEnv class to open a BerkleyDB
@@ -250,8 +855,237 @@ protected:
     virtual void db_open(uint flags = 0);
 };
 
+/**
+ * @class RecordFilter - predicates compiled against a table's columns
+ *
+ * Checks a record on its marshaled bytes: INT columns are read where they sit and compared,
+ * TEXT columns are compared on their length and then their bytes, and columns that aren't
+ * tested are never looked at. Nothing is unmarshaled or allocated per record.
+ */
+class RecordFilter {
+public:
+    /**
+     * @param where predicates that must all hold
+     * @param column_names the table's columns, in order
+     * @param layout the table's record format (must outlive the filter)
+     * @throws DbRelationError for an unknown column or a value of the wrong type
+     */
+    RecordFilter(const Predicates &where, const ColumnNames &column_names, const RowLayout &layout);
+
+    virtual ~RecordFilter() {}
+
+    /**
+     * do all the predicates hold for this record?
+     * @param record marshaled record (e.g. from DbBlock::view)
+     */
+    virtual bool matches(const RecordView &record) const;
+
+    /**
+     * could any record of a block match, going by its zone map bounds and Bloom filters?
+     * @param zones the table's zone map
+     * @param blooms the table's Bloom filters, nullptr if it has none
+     * @param block_id which block
+     */
+    virtual bool may_match(const ZoneMap &zones, const BloomFilters *blooms, BlockID block_id) const;
+
+    /**
+     * check all of a PAX block's records at once, a column at a time: for INT columns
+     * that is a tight compare loop over the minipage's array of values.
+     * @param page the block
+     * @param selected set to 1 at [record id] for the live records that match, 0 elsewhere
+     */
+    virtual void select(const PaxPage &page, std::vector<char> &selected) const;
+
+protected:
+    /**
+     * one predicate, by column number
+     */
+    class Test {
+    public:
+        uint column;
+        Predicate::Op op;
+        bool by_code; // compare n with a dictionary-encoded column's codes
+        int32_t n;
+        std::string s;
+        u_int64_t zone_key; // the value as a ZoneMap key
+        u_int64_t bloom_hash; // the value's BloomFilters::hash
+    };
+
+    const RowLayout &layout;
+    std::vector<Test> tests;
+
+    /**
+     * does a comparison result (<0, 0, >0) satisfy op?
+     */
+    static bool holds(Predicate::Op op, int comparison);
+};
+
+/**
+ * @class HeapTableCursor - lazy handle cursor over a heap file
+ *
+ * Keeps one block at a time pinned in the table's buffer pool and walks its live
+ * records, moving on to the next block id when that one runs out.
+ * A row that was moved by an update is returned where its forwarding stub is, under its
+ * original handle, and skipped where it now lives, so each row comes out once.
+ * The cursor takes a Snapshot when it is made and sees the rows as they were then: rows
+ * inserted or deleted afterwards are left out or kept in, and rows updated afterwards are
+ * filtered on their old versions, so changes made while it is open don't show up halfway.
+ * With read-ahead, blocks that are not already cached are fetched read_ahead at a
+ * time with HeapFile::get_many() and walked from that window, bypassing the pool
+ * so a big scan does not flush everyone else's blocks out of it.
+ * Delete the cursor before closing the table.
+ */
+class HeapTableCursor : public DbRelationCursor {
+public:
+    /**
+     * @param file the heap file to walk (must stay open while the cursor is used)
+     * @param pool the buffer pool caching the file's blocks
+     * @param layout the table's record format, to tell stubs and moved rows apart
+     * @param versions the table's old row versions
+     * @param read_ahead blocks per bulk read
+     * @param filter rows must match this (the cursor frees it), nullptr for all rows
+     * @param zones if given, blocks it shows the filter can't match are skipped without being read
+     * @param blooms likewise for Bloom filters, nullptr if the table has none
+     */
+    HeapTableCursor(HeapFile &file, BufferPool &pool, const RowLayout &layout, const VersionStore &versions,
+                    uint read_ahead = 1, RecordFilter *filter = nullptr, const ZoneMap *zones = nullptr,
+                    const BloomFilters *blooms = nullptr)
+        : file(file), pool(pool), layout(layout), versions(versions), snapshot(VersionClock::take()),
+          block_id(0), record_id(0), block(nullptr), pinned(false), read_ahead(read_ahead), window_first(0),
+          filter(filter), zones(zones), blooms(blooms), pax(nullptr), selecting(false) {}
+
+    virtual ~HeapTableCursor();
+
+    HeapTableCursor(const HeapTableCursor &other) = delete;
+
+    HeapTableCursor &operator=(const HeapTableCursor &other) = delete;
+
+    /**
+     * advance to the next row (that passes the filter, if there is one)
+     * @param handle set to the next row's handle
+     * @return false when every block has been walked
+     */
+    virtual bool next(Handle &handle);
+
+protected:
+    HeapFile &file;
+    BufferPool &pool;
+    const RowLayout &layout;
+    const VersionStore &versions;
+    Snapshot snapshot; // rows are seen as they were when the cursor was made
+    BlockID block_id; // block we are on (0 before the first)
+    RecordID record_id; // record we are on within it
+    DbBlock *block; // current block, nullptr between blocks
+    bool pinned; // block is pinned in the pool (otherwise it is in the read-ahead window)
+    uint read_ahead; // blocks per bulk read, 1 to go block by block through the pool
+    std::vector<char> bulk; // memory of the read-ahead window
+    std::vector<DbBlock *> window; // blocks of the last bulk read
+    BlockID window_first; // block id of window[0]
+    RecordFilter *filter; // rows must match this (owned), nullptr for all rows
+    const ZoneMap *zones; // to skip blocks with, nullptr to read them all
+    const BloomFilters *blooms; // to skip blocks with too, nullptr if there are none
+    PaxPage *pax; // block as a PaxPage, nullptr if it is a SlottedPage
+    bool selecting; // block is a PaxPage, filtered up front into selected
+    std::vector<char> selected; // which records of the block matched, by record id
+
+    /**
+     * get the block for block_id: from the pool if cached, else from the read-ahead window
+     * (refilled as needed), else pinned from the pool
+     */
+    virtual void fetch(void);
+
+    /**
+     * done with the current block
+     */
+    virtual void release(void);
+
+    /**
+     * does the current record's row (following its stub) pass, in the version the snapshot sees?
+     * @param handle the record's handle
+     * @return false for a moved row (it is visited at its stub), an invisible row or one the
+     *         filter rules out
+     */
+    virtual bool visit(Handle handle);
+
+    /**
+     * is a version of the row with this handle visible to the snapshot, and does it match?
+     */
+    virtual bool matches(Handle handle, RecordView record) const;
+
+    /**
+     * free the read-ahead window's blocks
+     */
+    virtual void clear_window(void);
+};
+
+/**
+ * @class HeapTableOptions - physical storage choices for a HeapTable, made when it is created
+ * (pass the same options again whenever the table is opened; the catalog keeps them for the
+ * tables created through it, see TableOptions).
+ */
+class HeapTableOptions {
+public:
+    /**
+     * where the blocks live: a Berkeley DB RecNo file (HeapFile) or a flat mmap'd file (MmapFile)
+     * An MMAP table can grow to MmapFile::MAX_BLOCKS blocks (256 GB), or fewer on a machine
+     * short of address space (see MmapFile::get_capacity()).
+     */
+    enum Backend {
+        BERKELEY_DB, MMAP
+    };
+
+    /**
+     * when the block inserts are going into gets written to the file:
+     * after every row, when inserts move on to another block, or only at close/flush/eviction
+     */
+    enum FlushPolicy {
+        FLUSH_EACH_ROW, FLUSH_ON_BLOCK_CHANGE, FLUSH_ON_CLOSE
+    };
+
+    /**
+     * how rows are kept inside a block: whole rows one after another (SlottedPage),
+     * or split into one minipage per column (PaxPage) for scans reading few columns
+     */
+    enum PageLayout {
+        SLOTTED, PAX
+    };
+
+    Backend backend;
+    FlushPolicy flush_policy;
+    PageLayout page_layout;
+    ColumnNames dictionary_columns; // TEXT columns stored as TextDictionary codes
+    ColumnNames bloom_columns; // columns with a Bloom filter per block (see BloomFilters)
+    uint scan_threads; // workers select() scans with (HeapTable::parallel_select), 1 for none, 0 for one per core
+    double vacuum_share; // most of the time a background vacuum may take (HeapTable::vacuum_step), 0 for none
+
+    HeapTableOptions()
+        : backend(BERKELEY_DB), flush_policy(FLUSH_ON_BLOCK_CHANGE), page_layout(SLOTTED), scan_threads(1),
+          vacuum_share(0) {}
+
+    HeapTableOptions(Backend backend)
+        : backend(backend), flush_policy(FLUSH_ON_BLOCK_CHANGE), page_layout(SLOTTED), scan_threads(1),
+          vacuum_share(0) {}
+
+    /**
+     * set one option from its name and value as text, e.g. ("page_layout", "PAX") or
+     * ("dictionary_columns", "a b") with the columns separated by spaces
+     * @param name the member's name
+     * @param value an enum value without its prefix (MMAP, EACH_ROW, ...), in any case
+     * @throws DbRelationError if there is no such option or the value is not one of its values
+     */
+    void set(const std::string &name, const std::string &value);
+
+    /**
+     * every option as a name and text value that set() reads back
+     */
+    std::vector<std::pair<std::string, std::string> > get_all() const;
+};
+
 /**
  * @class HeapTable - Heap storage engine (implementation of DbRelation)
+ *
+ *      Not for use by more than one thread at a time, except that a background vacuum
+        (see vacuum_step) may work on it in between calls: every public method holds the latch.
  */
 class HeapTable : public DbRelation {
 public:
@@ -264,12 +1098,14 @@ public:
      * @param table_name name of the table
      * @param coumns_names an array of column names
      * @param column_attributes an array of actual data for each column
+     * @param options storage choices, e.g. which file backend to use
      */
-    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes);
+    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+              const HeapTableOptions &options = HeapTableOptions());
 
 
-    // dtor -> not implemented
-    virtual ~HeapTable() {}
+    // dtor
+    virtual ~HeapTable();
 
     // not implemented
     HeapTable(const HeapTable &other) = delete;
@@ -327,19 +1163,44 @@ public:
      */
     virtual Handle insert(const ValueDict *row);
 
+    /**
+     * insert a row given by column number, without going through a ValueDict.
+     * @param row one value per column (null where Row::is_null)
+     * @return the location of the new row (a pair of BlockID and RecordID)
+     */
+    virtual Handle insert(const Row *row);
+
+    /**
+     * corresponds to the SQL command COPY <table> FROM <file>. Loads delimited text, one row per
+     * line with the fields in column order, without going through insert(): the input is read in
+     * BULK_CHUNK_SZ chunks, each line is marshaled straight from its fields, and rows are packed
+     * into fresh blocks built in memory, each written once to the end of the file when full.
+     * CSV fields may be double-quoted ("" inside quotes is a quote).
+     * @param in the input
+     * @param delimiter field separator, e.g. ',' or '\t'
+     * @param header whether the first line is column names to skip
+     * @return number of rows loaded
+     */
+    virtual u_int32_t bulk_load(std::istream &in, char delimiter = ',', bool header = false);
+
     /**
      * corresponds to the SQL command UPDATE. Like insert, but only applies specific
      * field changes, keeping other fields as they were before. Same logic as insert
      * for constraints, defaults, etc. The client needs to first obtain a handle to
      * the row that is meant to be updated either from insert or from select.
+     * The row is rewritten in place when it still fits in its block. When it doesn't, it moves
+     * to a block with room and its old record becomes a forwarding stub, so the handle (and
+     * every index entry) stays good; a moved row comes back once it fits at home again.
      * @param handle the location of the new row(a pair of BlockID and RecordID)
      * @param new_values row's data (an array of pair of column name and its value)
+     * @throws DbRelationError for an unknown column or a value of the wrong type
      */
     virtual void update(const Handle handle, const ValueDict *new_values);
 
     /**
      * corresponds to the SQL command DELETE FROM. Deletes a row for a given
-     * row handle (obtained from insert or select).
+     * row handle (obtained from insert or select), along with its stub if it was moved
+     * and its index entries. Its record id is reused by later inserts into the block.
      * @param handle the location of the row
      */
     virtual void del(const Handle handle);
@@ -353,43 +1214,421 @@ public:
      */
     virtual Handles *select();
 
-    // WHERE... is not supported for this sprint
+    /**
+     * Return handles of the rows whose columns equal the given values
+     * (SELECT ... WHERE col1 = val1 AND col2 = val2 ...).
+     * @param where column values to match
+     * @return a array of matching rows' handle
+     */
     virtual Handles *select(const ValueDict *where);
 
+    /**
+     * Return handles of the rows for which all the predicates hold. The predicates are checked
+     * on each record's marshaled bytes during the scan; rows are only unmarshaled by project().
+     * When an index covers the predicates, only the rows it points to are checked; otherwise
+     * the scan is spread over threads if options.scan_threads asks for it.
+     * @param where predicates (=, <>, <, <=, >, >=) that must all hold
+     * @return a array of matching rows' handle
+     */
+    virtual Handles *select(const Predicates *where);
+
+    /**
+     * cursor version of select(): handles are found block by block as it advances.
+     * @return a cursor over all rows' handle (freed by caller)
+     */
+    virtual DbRelationCursor *scan();
+
+    /**
+     * cursor version of select(where).
+     * @param where predicates that must all hold
+     * @return a cursor over matching rows' handle (freed by caller)
+     */
+    virtual DbRelationCursor *scan(const Predicates *where);
+
+    /**
+     * select(where) spread over worker threads. The file is cut into morsels of read_ahead
+     * blocks; a worker reads a whole morsel in one bulk read, then filters (and projects) its
+     * rows on its own, and takes morsels from other workers when it runs out (WorkStealingPool).
+     * Workers read the file, not the buffer pool, so modified blocks are flushed first, and
+     * their reads take turns (Berkeley DB handles aren't shared between threads otherwise).
+     * Indexes are not used.
+     * @param where predicates that must all hold, nullptr for every row
+     * @param column_names fields to extract into rows (nullptr for all of them)
+     * @param rows if given, set to the matching rows, in the same order as the handles (freed by caller)
+     * @return matching rows' handles, in the order select() gives them (freed by caller)
+     */
+    virtual Handles *parallel_select(const Predicates *where, const ColumnNames *column_names = nullptr,
+                                     Rows **rows = nullptr);
+
+    /**
+     * how many workers select() scans with from now on (see HeapTableOptions::scan_threads)
+     */
+    virtual void set_scan_threads(uint threads);
+
+    /**
+     * gather statistics (ANALYZE) from a random sample of blocks, read through the file, and
+     * keep them up to date as rows are inserted from then on (see StatsBuilder).
+     * @param sample_blocks most blocks to read (all of a table with no more than that)
+     * @return the statistics, kept by the table (see get_stats)
+     */
+    virtual const TableStats &analyze(u_int32_t sample_blocks = ANALYZE_SAMPLE_BLOCKS);
+
+    /**
+     * the table's statistics, nullptr if it was never analyzed
+     */
+    virtual const TableStats *get_stats(void) const { return stats; }
+
+    /**
+     * statistics gathered earlier (e.g. saved in the catalog), kept up to date from now on
+     */
+    virtual void set_stats(const TableStats &stats);
+
+    /**
+     * how many times the statistics have changed, so a saved copy can tell it is out of date
+     */
+    virtual u_int32_t get_stats_version(void) const { return stats_version; }
+
+    /**
+     * one step of a vacuum pass over the file, if the table isn't busy. A pass goes through the
+     * file twice. On the way up each block is compacted, so the room deleted and shrunk rows left
+     * is in one piece, and the forwarding stubs are noted. On the way back down, rows that an
+     * update moved out of their home block are packed into earlier blocks with room (their stubs
+     * are pointed at the new place, so handles stay good) when they are all a sparse block holds,
+     * or when they are in the last block; then empty blocks at the end of the file are given
+     * back (HeapFile::truncate). A row that was never moved stays in its home block, since its
+     * handle (in indexes and in callers' hands) names that block.
+     * Nothing happens while any snapshot is in use, as a cursor may have the blocks in hand.
+     * @param max_blocks most blocks to go through in this step
+     * @return whether the pass has more to do; false once it is over, or if it couldn't run now
+     */
+    virtual bool vacuum_step(uint max_blocks = VACUUM_STEP_BLOCKS);
+
+    /**
+     * a whole vacuum pass now (from the start, if one was going)
+     */
+    virtual void vacuum();
+
+    /**
+     * how much of the time a background thread may spend running vacuum_step
+     * (see HeapTableOptions::vacuum_share); 0 stops the thread
+     */
+    virtual void set_vacuum_share(double share);
+
+    /**
+     * how many blocks a scan reads per Berkeley DB call (1 turns read-ahead off).
+     * @param blocks read-ahead window size
+     */
+    virtual void set_read_ahead(uint blocks);
+
     /**
      * extracts a row from the table (a projection).
      * @param handle locatiton of the row
      */
     virtual ValueDict *project(Handle handle);
 
+    /**
+     * extracts a row from the table by column number, without building a ValueDict.
+     * @param handle locatiton of the row
+     * @param row set to the row's values
+     * @param snapshot the version to read (e.g. a cursor's), nullptr for the current one
+     * @throws DbRecordIdNotFound if the row isn't there (in that snapshot)
+     */
+    virtual void project(Handle handle, Row &row, const Snapshot *snapshot = nullptr);
+
     /**
      * extracts specific fields from a row handle (a projection).
+     * Only those fields are decoded; the others are never touched.
      * @param handle locatiton of the row
      * @param column_names fields to extract
+     * @throws DbRelationError for an unknown column
      */
     virtual ValueDict *project(Handle handle, const ColumnNames *column_names);
 
+    /**
+     * extracts specific fields from many rows at once, e.g. everything select() returned.
+     * Handles are grouped by block so each block is pinned once and all of its requested
+     * records are decoded while it is held.
+     * @param handles locations of the rows
+     * @param column_names fields to extract (nullptr for all of them)
+     * @param snapshot the versions to read, nullptr for the current ones
+     * @return one Row per handle, in the same order, with the fields in column_names order
+     *         (freed by caller)
+     * @throws DbRelationError for an unknown column
+     * @throws DbRecordIdNotFound if a row isn't there (in that snapshot)
+     */
+    virtual Rows *project_batch(const Handles &handles, const ColumnNames *column_names = nullptr,
+                                const Snapshot *snapshot = nullptr);
+
+    /**
+     * keep an index up to date from now on and let select() use it.
+     * @param index an open index on this table (owned by the caller, who removes it before freeing it)
+     */
+    virtual void add_index(DbIndex *index);
+
+    /**
+     * stop maintaining an index
+     */
+    virtual void remove_index(DbIndex *index);
+
     /**
      * test unmarshall()
      * developer's own unit test
      */
     virtual bool test_unmarshal();
+
+    /**
+     * the buffer pool caching this table's blocks (to resize it or read its hit/miss counters)
+     */
+    virtual BufferPool &get_buffer_pool();
+
+    /**
+     * number of blocks in the table's file (e.g. to see what a vacuum gave back)
+     */
+    virtual u_int32_t get_block_count();
+
+    /**
+     * write every modified block back to the file and sync it (the table stays open).
+     */
+    virtual void flush();
+
+    /**
+     * change when the block being inserted into gets written out.
+     * @param flush_policy see HeapTableOptions::FlushPolicy
+     */
+    virtual void set_flush_policy(HeapTableOptions::FlushPolicy flush_policy);
+
+    virtual const HeapTableOptions &get_options() const { return options; }
+
+    static const uint DEFAULT_READ_AHEAD = 32; // blocks per bulk read in scans
+    static const uint BULK_CHUNK_SZ = 1 << 16; // bytes read at a time by bulk_load
+    static const u_int32_t ANALYZE_SAMPLE_BLOCKS = 256; // blocks analyze() reads by default
+    static const uint VACUUM_STEP_BLOCKS = 16; // blocks vacuum_step() goes through by default
+    static const u_int16_t VACUUM_SPARSE_BYTES = DbBlock::BLOCK_SZ / 4; // rows in a block this sparse are moved out
 protected:
-    HeapFile file;
+    HeapTableOptions options;
+    HeapFile *file; // HeapFile or MmapFile, per options.backend
+    BufferPool pool; // cached blocks of file, written back on eviction and close
+    uint read_ahead; // blocks per bulk read in scans
+    DbBlock *insert_block; // block appends go to, kept pinned (and dirty) between inserts
+    RowLayout layout; // record format, from column_attributes
+    std::vector<TextDictionary *> dictionaries; // of the options.dictionary_columns, saved in <table>.<column>.dict
+    std::vector<DbIndex *> indexes; // updated by every insert, consulted by select(where)
+    ZoneMap zones; // bounds of each block's values, saved in <table>.zone
+    BloomFilters *blooms; // of the options.bloom_columns, saved in <table>.bloom
+    bool block_maps_saved; // the saved zone map and Bloom filters cover every block (see block_maps_changing)
+    VersionStore versions; // old versions of updated rows, for snapshots older than the update
+    std::vector<std::pair<Timestamp, Handle>> dead; // rows deleted while a snapshot could see them, and when
+    WorkStealingPool *workers; // for parallel_select, started on first use
+    std::mutex io; // held by parallel_select's workers while they read the file
+    TableStats *stats; // from analyze() or set_stats(), nullptr before
+    StatsBuilder *inserted; // rows inserted since stats was last brought up to date
+    u_int64_t deleted_since_stats; // rows deleted since then
+    u_int32_t stats_version;
+    std::recursive_mutex latch; // held by every public method, so vacuum_step() only runs in between
+    VacuumThread *vacuum_thread; // runs vacuum_step() if options.vacuum_share asks for it
+    BlockID vacuum_next; // block the vacuum pass does next, 0 when there is no pass going
+    bool vacuum_down; // the pass is on its way back down
+    bool vacuum_truncated; // the pass gave blocks back
+    std::map<Handle, Handle> vacuum_homes; // moved rows the pass knows the stubs of: where each one is -> its handle
+
+    /**
+     * where a dictionary-encoded column's dictionary is saved
+     */
+    virtual std::string dictionary_path(uint col_num);
+
+    /**
+     * use an index for select(where) if one covers the predicates: all of its key columns
+     * compared with =, or its one column bounded by <, <=, >, >= or =.
+     * @param where predicates that must all hold
+     * @return candidate handles in file order, some of which may not match (freed by caller),
+     *         or nullptr if no index helps
+     */
+    virtual Handles *index_candidates(const Predicates *where);
+
+    /**
+     * check that indexes can take a row before it goes into the table (see DbIndex::check)
+     * @param record the marshaled row
+     * @param indexes the indexes it will be inserted into
+     * @throws DbRelationError if one of them can't
+     */
+    virtual void check_indexes(const RecordView &record, const std::vector<DbIndex *> &indexes);
+
+    /**
+     * where the zone map is saved
+     */
+    virtual std::string zone_map_path();
 
     /**
-     * validate the content of the row.
-     * prints out error message in the console if error occurs
+     * where the Bloom filters are saved
+     */
+    virtual std::string bloom_path();
+
+    /**
+     * work the zone map and Bloom filters out again from every record in the file
+     */
+    virtual void rebuild_block_maps();
+
+    /**
+     * write out the zone map and Bloom filters
+     */
+    virtual void save_block_maps();
+
+    /**
+     * call before the zone map or Bloom filters change: the first change after they were saved
+     * removes the saved ones, so a table that isn't closed (or flushed) again has them worked out
+     * afresh on open rather than trusting bounds narrower than its blocks
+     */
+    virtual void block_maps_changing();
+
+    /**
+     * widen a block's zone bounds and Bloom filters to cover a record
+     */
+    virtual void widen_block_maps(BlockID block_id, const RecordView &record);
+
+    /**
+     * widen a block's zone bounds and Bloom filters to cover every row a scan finds there
+     * (a moved row's copy too, through its stub)
+     * @param block the block, pinned
+     */
+    virtual void widen_block_maps(DbBlock *block);
+
+    /**
+     * write out the dictionaries that got new values
+     */
+    virtual void save_dictionaries();
+
+    /**
+     * stop appending to insert_block: unpin it and, per the flush policy, write it out
+     */
+    virtual void release_insert_block();
+
+    /**
+     * validate the content of the row and put its values in column order.
      * @param row the location of the row
+     * @return the row by column number (freed by caller), its TEXT values viewing row's, so
+     *         it is only good while row is
+     * @throws DbInvalidRowError if a column is missing
      */
-    virtual ValueDict *validate(const ValueDict *row);
+    virtual Row *validate(const ValueDict *row);
+
+    /**
+     * where each of the given columns is in the table.
+     * @param column_names columns to look up
+     * @return their column numbers, in the same order
+     * @throws DbRelationError for an unknown column
+     */
+    virtual std::vector<uint> column_numbers(const ColumnNames *column_names);
+
+    /**
+     * the ValueDict for a row (null columns are left out).
+     * @param row the row by column number, its values moved out
+     * @return the row by column name (freed by caller)
+     */
+    virtual ValueDict *to_dict(Row &row);
 
     /**
      * appends one more row in the table
      * @param row the location of the new row
      * @return the handle of the new row
      */
-    virtual Handle append(const ValueDict *row);
+    virtual Handle append(const Row *row);
+
+    /**
+     * put a marshaled record in the block inserts go to, or else in one with room for it
+     * (no indexes are updated)
+     * @param record the record
+     * @return where it went
+     */
+    virtual Handle add_record(const RecordView &record);
+
+    /**
+     * replace a row's record with a new one: in place if it fits, else moved elsewhere
+     * behind a forwarding stub (see update)
+     * @param handle the row's handle
+     * @param bytes the new record (its moved flag is set if it has to move)
+     * @param size its size
+     */
+    virtual void rewrite(Handle handle, char *bytes, u_int16_t size);
+
+    /**
+     * one parallel_select() task: the rows of blocks first through first + count - 1
+     * @param filter predicates, nullptr for every row
+     * @param snapshot version of the rows to read
+     * @param col_nums fields to extract if rows is given
+     * @param handles matching rows are added here
+     * @param rows and projected here, if not nullptr
+     */
+    virtual void scan_morsel(BlockID first, uint count, const RecordFilter *filter, const Snapshot &snapshot,
+                             const std::vector<uint> &col_nums, Handles &handles, Rows *rows);
+
+    /**
+     * keep the statistics up to date with an inserted row, folding in the rows inserted since
+     * they were gathered once there are enough of them
+     */
+    virtual void stats_insert(const RecordView &record);
+
+    /**
+     * forget the statistics (the rows are gone)
+     */
+    virtual void clear_stats(void);
+
+    /**
+     * copy out the current version of a row
+     * @param handle the row
+     * @param bytes where to copy it (DbBlock::BLOCK_SZ bytes)
+     * @return its size
+     * @throws DbRecordIdNotFound if the row was deleted
+     */
+    virtual u_int16_t copy_row(Handle handle, char *bytes);
+
+    /**
+     * take a row (and its stub, if it moved) out of the file, giving its room back
+     */
+    virtual void erase(Handle handle);
+
+    /**
+     * drop the old versions and erase the deleted rows no snapshot in use can see any more
+     */
+    virtual void prune_versions();
+
+    /**
+     * vacuum pass on its way up: compact a block and note the stubs in it
+     */
+    virtual void vacuum_compact(BlockID block_id);
+
+    /**
+     * vacuum pass on its way down: move the moved rows out of a block if it is sparse or the
+     * last one, then give it back if it is empty and at the end of the file
+     */
+    virtual void vacuum_empty(BlockID block_id);
+
+    /**
+     * move a moved row to an earlier block with room, pointing its stub at the new place
+     * @param block the block it is in, pinned
+     * @param record_id where it is in the block
+     * @return false if it can't go (it isn't a moved row the pass knows of, or there is no room)
+     */
+    virtual bool vacuum_move(DbBlock *block, RecordID record_id);
+
+    /**
+     * start or stop the vacuum thread per options.vacuum_share
+     */
+    virtual void start_vacuum_thread();
+
+    /**
+     * pin the block a row is in, following its stub if it was moved.
+     * @param handle the row's handle
+     * @param record_id set to the row's record id in the returned block
+     * @return the block, pinned (the caller unpins it)
+     * @throws DbRelationError if the handle is a moved row's new place rather than its own
+     */
+    virtual DbBlock *pin_row(Handle handle, RecordID &record_id);
+
+    /**
+     * done changing a block: mark it dirty, note its free space, write it out if the flush
+     * policy says so, and unpin it
+     */
+    virtual void release_block(DbBlock *block);
 
     /**
      * return the bits to go into the file.
@@ -398,12 +1637,30 @@ protected:
      */
     virtual Dbt *marshal(const ValueDict *row);
 
+    /**
+     * marshal one line of delimited text the same way marshal() does a row, without a ValueDict.
+     * @param line the line (without its newline)
+     * @param delimiter field separator
+     * @param bytes where to marshal to (DbBlock::BLOCK_SZ bytes)
+     * @return size of the marshaled row
+     * @throws DbRelationError if the fields don't match the columns
+     */
+    virtual u_int16_t marshal_text(const std::string &line, char delimiter, char *bytes);
+
     /**
      * decode the content in Dbt and return ValueDict
+     * (the Dbt and its data are still owned by the caller)
      * @param data address of the data
      * @return content of the row
      */
     virtual ValueDict *unmarshal(Dbt *data);
+
+    /**
+     * decode a record straight out of a block's memory and return ValueDict
+     * @param data borrowed view of the record (e.g. from SlottedPage::view)
+     * @return content of the row
+     */
+    virtual ValueDict *unmarshal(const RecordView &data);
 };
 
 /**
@@ -0,0 +1,138 @@
+/**
+ * @file mmap_file.cpp - MmapFile implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mmap_file.h"
+
+MmapFile::~MmapFile() {
+    if (!this->closed)
+        this->close();
+}
+
+void MmapFile::close(void) {
+    if (this->closed)
+        return;
+    this->sync();
+    munmap(this->base, (size_t) this->capacity * DbBlock::BLOCK_SZ);
+    ::close(this->fd);
+    this->base = nullptr;
+    this->fd = -1;
+    this->closed = true;
+}
+
+bool MmapFile::exists(void) {
+    struct stat st;
+    return stat(home_path(this->name + ".pages").c_str(), &st) == 0;
+}
+
+void MmapFile::sync(void) {
+    if (this->last > 0)
+        msync(this->base, (size_t) this->last * DbBlock::BLOCK_SZ, MS_SYNC);
+    this->fsm.save(home_path(this->name + ".fsm"));
+}
+
+DbBlock* MmapFile::get_new(void) {
+    return this->get_new(nullptr);
+}
+
+DbBlock* MmapFile::get_new(char *buffer) {
+    if (this->last >= this->capacity)
+        throw DbRelationError("mmap file " + this->dbfilename + " is full (" + std::to_string(this->capacity)
+                              + " blocks)");
+    // extending the file makes the next (zero-filled) block of the mapping usable
+    if (ftruncate(this->fd, (off_t) (this->last + 1) * DbBlock::BLOCK_SZ) != 0)
+        throw DbRelationError("could not grow " + this->dbfilename);
+    BlockID block_id = ++this->last;
+    Dbt data(address(block_id), DbBlock::BLOCK_SZ);
+    DbBlock* page = this->make_block(data, block_id, true);
+    this->fsm.update(block_id, page->get_free_space());
+    return page;
+}
+
+DbBlock* MmapFile::get(BlockID block_id) {
+    Dbt data(address(block_id), DbBlock::BLOCK_SZ);
+    return this->make_block(data, block_id, false);
+}
+
+DbBlock* MmapFile::get(BlockID block_id, char *buffer) {
+    return this->get(block_id);
+}
+
+void MmapFile::put(DbBlock *block) {
+    char *home = address(block->get_block_id());
+    if (block->get_data() != home)
+        std::memcpy(home, block->get_data(), DbBlock::BLOCK_SZ);
+    this->fsm.update(block->get_block_id(), block->get_free_space());
+}
+
+void MmapFile::put_new(DbBlock *block) {
+    if (block->get_block_id() != this->last + 1 || this->last >= this->capacity)
+        throw DbRelationError("new block must be block " + std::to_string(this->last + 1));
+    if (ftruncate(this->fd, (off_t) (this->last + 1) * DbBlock::BLOCK_SZ) != 0)
+        throw DbRelationError("could not grow " + this->dbfilename);
+    this->last++;
+    this->put(block);
+}
+
+void MmapFile::truncate(BlockID last) {
+    if (last >= this->last)
+        return;
+    if (ftruncate(this->fd, (off_t) last * DbBlock::BLOCK_SZ) != 0)
+        throw DbRelationError("could not shrink " + this->dbfilename);
+    this->last = last;
+    this->fsm.truncate(last);
+}
+
+void MmapFile::get_many(BlockID first, uint count, std::vector<char> &bulk, std::vector<DbBlock *> &blocks) {
+    madvise(address(first), (size_t) count * DbBlock::BLOCK_SZ, MADV_WILLNEED);
+    for (BlockID block_id = first; block_id < first + count; block_id++)
+        blocks.push_back(this->get(block_id));
+}
+
+void MmapFile::advise(Access access) {
+    int advice = access == SEQUENTIAL ? MADV_SEQUENTIAL : access == RANDOM ? MADV_RANDOM : MADV_NORMAL;
+    if (this->last > 0)
+        madvise(this->base, (size_t) this->last * DbBlock::BLOCK_SZ, advice);
+}
+
+// protected
+void MmapFile::db_open(uint flags) {
+    if (!this->closed)
+        return;
+    this->dbfilename = this->name + ".pages";
+    std::string path = home_path(this->dbfilename);
+    int open_flags = O_RDWR;
+    if (flags & DB_CREATE)
+        open_flags |= O_CREAT;
+    if (flags & DB_TRUNCATE)
+        open_flags |= O_TRUNC;
+    this->fd = ::open(path.c_str(), open_flags, 0644);
+    if (this->fd < 0)
+        throw DbRelationError("could not open " + path);
+    struct stat st;
+    fstat(this->fd, &st);
+    this->last = st.st_size / DbBlock::BLOCK_SZ;
+    // map the most the file may ever grow to, so blocks never move as it does; if the address
+    // space for that isn't there, settle for less, as long as the file as it is fits
+    void *mapping = MAP_FAILED;
+    for (this->capacity = MAX_BLOCKS; this->capacity > 0 && this->capacity >= this->last; this->capacity /= 2) {
+        mapping = mmap(nullptr, (size_t) this->capacity * DbBlock::BLOCK_SZ, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_NORESERVE, this->fd, 0);
+        if (mapping != MAP_FAILED)
+            break;
+    }
+    if (mapping == MAP_FAILED) {
+        ::close(this->fd);
+        this->fd = -1;
+        throw DbRelationError("could not map " + path);
+    }
+    this->base = (char *) mapping;
+    this->closed = false;
+}
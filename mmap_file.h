@@ -0,0 +1,140 @@
+/**
+ * @file mmap_file.h - Memory-mapped alternative to the Berkeley DB heap file.
+ * MmapFile: HeapFile
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include "heap_storage.h"
+
+/**
+ * @class MmapFile - heap file kept in a flat file of fixed-size blocks that is mmap'd.
+ *
+ *      Same heap file organization as HeapFile (SlottedPage or PaxPage blocks, free-space map),
+        but block i lives at byte (i - 1) * BLOCK_SZ of <name>.pages instead of in a Berkeley DB RecNo record.
+        The whole file is mapped once into an address range big enough for MAX_BLOCKS, and grows
+        with ftruncate, so blocks handed out by get() point straight into the mapping and never
+        move: there is no copy on read, and put() has nothing to copy back. The range is only
+        address space (nothing is allocated for it until the file grows into it); where even that
+        can't be had, as much as can is reserved, and the file can't grow past it. The kernel page cache
+        does the buffering; advise() passes access-pattern hints on to it.
+ */
+class MmapFile : public HeapFile {
+public:
+    /**
+     * access-pattern hints for advise()
+     */
+    enum Access {
+        NORMAL, SEQUENTIAL, RANDOM
+    };
+
+    static const u_int32_t MAX_BLOCKS = 1 << 26; // address space reserved per file (256 GB of blocks)
+
+    /**
+     * constructor
+     * @param name of the file (without extension)
+     */
+    MmapFile(std::string name) : HeapFile(name), fd(-1), base(nullptr), capacity(0) {}
+
+    // closes the file if it is still open
+    virtual ~MmapFile();
+
+    // not implemented
+    MmapFile(const MmapFile &other) = delete;
+
+    // not implemented
+    MmapFile &operator=(const MmapFile &other) = delete;
+
+    /**
+     * unmap and close the file, saving the free-space map.
+     */
+    virtual void close(void);
+
+    /**
+     * whether <name>.pages is already there
+     */
+    virtual bool exists(void);
+
+    /**
+     * msync the mapping and save the free-space map.
+     */
+    virtual void sync(void);
+
+    /**
+     * grow the file by one block and return it, initialized, in the mapping.
+     */
+    virtual DbBlock *get_new(void);
+
+    /**
+     * same as get_new(); the buffer is not needed since the block lives in the mapping.
+     */
+    virtual DbBlock *get_new(char *buffer);
+
+    /**
+     * the block as it sits in the mapping (no copy).
+     * @param block_id which block to get
+     * @returns pointer to the DbBlock (freed by caller)
+     */
+    virtual DbBlock *get(BlockID block_id);
+
+    /**
+     * same as get(block_id); the buffer is not needed since the block lives in the mapping.
+     */
+    virtual DbBlock *get(BlockID block_id, char *buffer);
+
+    /**
+     * blocks from get() were changed in place, so only a block built elsewhere is copied in.
+     * @param block the block to write
+     */
+    virtual void put(DbBlock *block);
+
+    /**
+     * grow the file by the block and copy it in.
+     * @param block a new block whose id is get_last_block_id() + 1
+     */
+    virtual void put_new(DbBlock *block);
+
+    /**
+     * shrink the file to its first last blocks (the mapping stays, past the end of the file).
+     * @param last the last block kept
+     */
+    virtual void truncate(BlockID last);
+
+    /**
+     * read-ahead: asks the kernel to start reading the blocks (MADV_WILLNEED) and returns them
+     * in place, so bulk is not used.
+     */
+    virtual void get_many(BlockID first, uint count, std::vector<char> &bulk, std::vector<DbBlock *> &blocks);
+
+    /**
+     * tell the kernel how the file is about to be read (madvise).
+     * @param access SEQUENTIAL for scans (aggressive read-ahead), RANDOM for lookups (none)
+     */
+    virtual void advise(Access access);
+
+    /**
+     * number of blocks the file can grow to while it is open (MAX_BLOCKS unless less could be mapped)
+     */
+    virtual u_int32_t get_capacity(void) const { return capacity; }
+
+protected:
+    int fd; // open file descriptor, -1 when closed
+    char *base; // start of the mapping
+    u_int32_t capacity; // blocks the mapping has room for
+
+    /**
+     * open (and with DB_CREATE | DB_TRUNCATE, create or empty) <name>.pages and map it.
+     * @param flags DB_CREATE, DB_TRUNCATE as for Berkeley DB
+     */
+    virtual void db_open(uint flags = 0);
+
+    /**
+     * where a block lives in the mapping
+     * @param block_id which block
+     * @return its first byte
+     */
+    virtual char *address(BlockID block_id) { return base + (size_t) (block_id - 1) * DbBlock::BLOCK_SZ; }
+};
@@ -0,0 +1,250 @@
+/**
+ * @file pax_page.cpp - PaxPage implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include <cstring>
+#include "pax_page.h"
+
+typedef u_int16_t u16;
+
+// bitmaps take whole 4-byte words so the value arrays after them stay aligned
+static u16 bitmap_bytes(u16 capacity) {
+    return (capacity + 31) / 32 * 4;
+}
+
+PaxPage::PaxPage(Dbt &block, BlockID block_id, bool is_new, const RowLayout &layout)
+    : DbBlock(block, block_id, is_new), layout(layout) {
+    if (is_new) {
+        this->num_records = 0;
+        this->capacity = capacity_for(layout);
+        this->var_start = DbBlock::BLOCK_SZ;
+        this->fragmented = 0;
+        put_header();
+    } else {
+        u16 header[4];
+        memcpy(header, data(), sizeof(header));
+        this->num_records = header[0];
+        this->capacity = header[1];
+        this->var_start = header[2];
+        this->fragmented = header[3];
+    }
+    this->bitmap_size = bitmap_bytes(this->capacity);
+    this->fixed_end = minipage(layout.size());
+    if (is_new)
+        memset(data() + BITMAP_OFFSET, 0, 3 * this->bitmap_size);
+}
+
+u16 PaxPage::capacity_for(const RowLayout &layout) {
+    uint text_columns = 0;
+    for (uint column = 0; column < layout.size(); column++)
+        if (has_text(layout, column))
+            text_columns++;
+    u16 capacity = 1;
+    while (true) {
+        u16 more = capacity + 1;
+        uint needed = HEADER_SZ + (layout.size() + 3) * bitmap_bytes(more)
+                      + more * (2 * sizeof(Timestamp) + layout.size() * sizeof(int32_t)
+                                + text_columns * AVERAGE_TEXT_SZ);
+        if (needed > DbBlock::BLOCK_SZ)
+            return capacity;
+        capacity = more;
+    }
+}
+
+u16 PaxPage::max_record_size(const RowLayout &layout) {
+    // where the minipages end, as minipage(layout.size()) works it out for a page's capacity
+    u16 capacity = capacity_for(layout);
+    u16 bitmap_size = bitmap_bytes(capacity);
+    uint fixed_end = BITMAP_OFFSET + 3 * bitmap_size + 2 * capacity * sizeof(Timestamp)
+                     + layout.size() * (bitmap_size + capacity * sizeof(int32_t));
+    return layout.get_fixed_size() + (DbBlock::BLOCK_SZ - fixed_end);
+}
+
+RecordID PaxPage::add(const Dbt *data) {
+    RecordID id = free_slot();
+    u16 size = text_size(*data);
+    if (id == 0 || size > this->var_start - this->fixed_end + this->fragmented)
+        throw DbBlockNoRoomError("not enough room for new record");
+    if (size > this->var_start - this->fixed_end)
+        compact();
+    if (id > this->num_records)
+        this->num_records = id;
+    store(id, *data);
+    put_header();
+    return id;
+}
+
+Dbt *PaxPage::get(RecordID record_id) {
+    RecordView record = this->view(record_id);
+    char *bytes = new char[record.size];
+    memcpy(bytes, record.data, record.size);
+    return new Dbt(bytes, record.size);
+}
+
+RecordView PaxPage::view(RecordID record_id) {
+    if (record_id == 0 || record_id > this->num_records || !is_live(record_id))
+        throw DbRecordIdNotFound("Record id does not exist: " + std::to_string(record_id));
+    this->scratch.resize(DbBlock::BLOCK_SZ);
+    char *bytes = this->scratch.data();
+    if (is_stub(record_id)) {
+        u_int32_t target;
+        memcpy(&target, data() + slot(record_id, 0), sizeof(target));
+        return RecordView(bytes, this->layout.encode_stub(RowLayout::unpack(target), bytes));
+    }
+    u16 end = this->layout.start(bytes);
+    this->layout.set_moved(bytes, is_moved(record_id));
+    this->layout.set_created(bytes, get_created(record_id));
+    this->layout.set_deleted(bytes, get_deleted(record_id));
+    for (uint column = 0; column < this->layout.size(); column++) {
+        if (is_null(record_id, column))
+            continue;
+        if (!has_text(column)) {
+            this->layout.put_int(bytes, column, int_values(column)[record_id - 1]);
+        } else {
+            RecordView value = text(record_id, column);
+            this->layout.put_text(bytes, column, value.data, value.size, end);
+        }
+    }
+    return RecordView(bytes, end);
+}
+
+void PaxPage::put(RecordID record_id, const Dbt &data) {
+    if (record_id == 0 || record_id > this->num_records || !is_live(record_id))
+        throw DbRecordIdNotFound("Record id does not exist: " + std::to_string(record_id));
+    u16 old_size = text_size(record_id);
+    u16 size = text_size(data);
+    if (size > this->var_start - this->fixed_end + this->fragmented + old_size)
+        throw DbBlockNoRoomError("Not enough room in block");
+    // the old text is garbage from here on; take the record out so compact() drops it
+    this->fragmented += old_size;
+    set_bit(BITMAP_OFFSET, record_id - 1, false);
+    if (size > this->var_start - this->fixed_end)
+        compact();
+    store(record_id, data);
+    put_header();
+}
+
+void PaxPage::del(RecordID record_id) {
+    if (record_id == 0 || record_id > this->num_records || !is_live(record_id))
+        throw DbRecordIdNotFound("Record id does not exist: " + std::to_string(record_id));
+    this->fragmented += text_size(record_id);
+    set_bit(BITMAP_OFFSET, record_id - 1, false);
+    put_header();
+}
+
+RecordIDs *PaxPage::ids(void) {
+    RecordIDs *record_ids = new RecordIDs;
+    for (RecordID record_id = next_id(); record_id != 0; record_id = next_id(record_id))
+        record_ids->push_back(record_id);
+    return record_ids;
+}
+
+RecordID PaxPage::next_id(RecordID record_id) {
+    for (RecordID id = record_id + 1; id <= this->num_records; id++)
+        if (is_live(id))
+            return id;
+    return 0;
+}
+
+u16 PaxPage::get_free_space(void) {
+    if (free_slot() == 0)
+        return 0;
+    return this->var_start - this->fixed_end + this->fragmented + this->layout.get_fixed_size();
+}
+
+bool PaxPage::compact(void) {
+    if (this->fragmented == 0)
+        return false;
+    // copy the text out, then lay the live records' text back down against the end of the block
+    char old[DbBlock::BLOCK_SZ];
+    memcpy(old + this->var_start, data() + this->var_start, DbBlock::BLOCK_SZ - this->var_start);
+    this->var_start = DbBlock::BLOCK_SZ;
+    for (RecordID id = next_id(); id != 0; id = next_id(id)) {
+        for (uint column = 0; column < this->layout.size(); column++) {
+            if (!has_text(column) || is_null(id, column))
+                continue;
+            u16 loc[2];
+            memcpy(loc, data() + slot(id, column), sizeof(loc));
+            this->var_start -= loc[1];
+            memcpy(data() + this->var_start, old + loc[0], loc[1]);
+            loc[0] = this->var_start;
+            memcpy(data() + slot(id, column), loc, sizeof(loc));
+        }
+    }
+    this->fragmented = 0;
+    put_header();
+    return true;
+}
+
+RecordView PaxPage::text(RecordID record_id, uint column) const {
+    TextDictionary *dictionary = this->layout.get_dictionary(column);
+    if (dictionary != nullptr)
+        return dictionary->value(int_values(column)[record_id - 1]);
+    u16 value[2];
+    memcpy(value, data() + slot(record_id, column), sizeof(value));
+    return RecordView(data() + value[0], value[1]);
+}
+
+// protected
+void PaxPage::set_bit(u16 offset, uint bit, bool on) {
+    if (on)
+        data()[offset + bit / 8] |= (char) (1 << (bit % 8));
+    else
+        data()[offset + bit / 8] &= (char) ~(1 << (bit % 8));
+}
+
+void PaxPage::put_header(void) {
+    u16 header[4] = {this->num_records, this->capacity, this->var_start, this->fragmented};
+    memcpy(data(), header, sizeof(header));
+}
+
+u16 PaxPage::text_size(RecordID record_id) const {
+    u16 size = 0;
+    for (uint column = 0; column < this->layout.size(); column++)
+        if (has_text(column) && !is_null(record_id, column))
+            size += text(record_id, column).size;
+    return size;
+}
+
+void PaxPage::store(RecordID record_id, const Dbt &data) {
+    RecordView record((const char *) data.get_data(), (u16) data.get_size());
+    for (uint column = 0; column < this->layout.size(); column++) {
+        bool null = this->layout.is_null(record, column);
+        set_bit(minipage(column), record_id - 1, null);
+        if (null)
+            continue;
+        if (!has_text(column)) {
+            int32_t n = this->layout.get_int(record, column);
+            memcpy(this->data() + slot(record_id, column), &n, sizeof(int32_t));
+        } else {
+            RecordView value = this->layout.get_text(record, column);
+            this->var_start -= value.size;
+            memcpy(this->data() + this->var_start, value.data, value.size);
+            u16 loc[2] = {this->var_start, value.size};
+            memcpy(this->data() + slot(record_id, column), loc, sizeof(loc));
+        }
+    }
+    bool stub = this->layout.is_stub(record);
+    if (stub) {
+        u_int32_t target = RowLayout::pack(this->layout.get_stub(record));
+        memcpy(this->data() + slot(record_id, 0), &target, sizeof(target));
+    }
+    Timestamp stamps[2] = {this->layout.get_created(record), this->layout.get_deleted(record)};
+    memcpy(this->data() + stamp(record_id, 0), &stamps[0], sizeof(Timestamp));
+    memcpy(this->data() + stamp(record_id, 1), &stamps[1], sizeof(Timestamp));
+    set_bit(BITMAP_OFFSET + this->bitmap_size, record_id - 1, stub);
+    set_bit(BITMAP_OFFSET + 2 * this->bitmap_size, record_id - 1, this->layout.is_moved(record));
+    set_bit(BITMAP_OFFSET, record_id - 1, true);
+}
+
+RecordID PaxPage::free_slot(void) const {
+    if (this->num_records < this->capacity)
+        return this->num_records + 1;
+    for (RecordID id = 1; id <= this->num_records; id++)
+        if (!is_live(id))
+            return id;
+    return 0;
+}
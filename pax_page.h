@@ -0,0 +1,222 @@
+/**
+ * @file pax_page.h - Column-wise (PAX) implementation of DbBlock.
+ * PaxPage: DbBlock
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <cstring>
+#include <vector>
+#include "db_cxx.h"
+#include "storage_engine.h"
+#include "row_codec.h"
+
+/**
+ * @class PaxPage - DbBlock holding a fixed number of rows column by column
+ *
+ *      Records come in (add/put) and go out (get/view) in RowLayout format like a SlottedPage's,
+        but inside the block each column has its own minipage, so a scan reading one INT column
+        walks one dense array instead of every row's bytes. After Ailamaki et al., "Weaving
+        Relations for Cache Performance" (VLDB 2001).
+            Bytes 0x00 - 0x01: number of records (slots handed out, including deleted ones)
+            Bytes 0x02 - 0x03: capacity, the most records the block can hold
+            Bytes 0x04 - 0x05: offset to the start of the text bytes (they grow down from the end)
+            Bytes 0x06 - 0x07: number of fragmented text bytes (left behind by del/put)
+            Then bitmaps of which record ids are in use, which are forwarding stubs (their
+            target is kept in the first column's slot) and which are moved rows (RowLayout's
+            flags), then capacity created stamps and capacity deleted stamps (u32 each), then
+            one minipage per column:
+                a null bitmap, then capacity 4-byte values (an INT, a TEXT's u16 offset
+                and u16 length, or a dictionary-encoded TEXT's code)
+            etc.
+        Bitmaps are padded to 4 bytes so each column's values form an aligned int32_t array.
+        Record id i is slot i - 1 of every minipage. Deleted ids are reused by add().
+ */
+class PaxPage : public DbBlock {
+public:
+    /**
+     * @param block the block's memory
+     * @param block_id its id
+     * @param is_new whether to format it as an empty block
+     * @param layout the record format of the table (must outlive the page)
+     */
+    PaxPage(Dbt &block, BlockID block_id, bool is_new, const RowLayout &layout);
+
+    virtual ~PaxPage() {}
+
+    PaxPage(const PaxPage &other) = delete;
+
+    PaxPage(PaxPage &&temp) = delete;
+
+    PaxPage &operator=(const PaxPage &other) = delete;
+
+    PaxPage &operator=(PaxPage &&temp) = delete;
+
+    /**
+     * split a RowLayout record into the column minipages.
+     * @param data marshaled record
+     * @return its record id
+     * @throws DbBlockNoRoomError if all slots are in use or its text doesn't fit
+     */
+    virtual RecordID add(const Dbt *data);
+
+    /**
+     * @return a copy of the record in RowLayout format (freed by caller, data too)
+     */
+    virtual Dbt *get(RecordID record_id);
+
+    /**
+     * the record reassembled in RowLayout format. Since its fields are spread over the block,
+     * the view points into the page's scratch buffer and only lasts until the next view().
+     */
+    virtual RecordView view(RecordID record_id);
+
+    virtual void put(RecordID record_id, const Dbt &data);
+
+    virtual void del(RecordID record_id);
+
+    virtual RecordIDs *ids(void);
+
+    virtual RecordID next_id(RecordID record_id = 0);
+
+    /**
+     * size of the largest record add() would take (0 when there is no free slot)
+     */
+    virtual u_int16_t get_free_space(void);
+
+    /**
+     * squeeze out the fragmented text bytes in one pass
+     * @return false if there were none
+     */
+    virtual bool compact(void);
+
+    /**
+     * number of record ids handed out (live or deleted): ids run 1 through this
+     */
+    u_int16_t size(void) const { return num_records; }
+
+    bool is_live(RecordID record_id) const { return test_bit(BITMAP_OFFSET, record_id - 1); }
+
+    bool is_stub(RecordID record_id) const { return test_bit(BITMAP_OFFSET + bitmap_size, record_id - 1); }
+
+    bool is_moved(RecordID record_id) const { return test_bit(BITMAP_OFFSET + 2 * bitmap_size, record_id - 1); }
+
+    bool is_null(RecordID record_id, uint column) const {
+        return test_bit(minipage(column), record_id - 1);
+    }
+
+    Timestamp get_created(RecordID record_id) const { return get_stamp(record_id, 0); }
+
+    Timestamp get_deleted(RecordID record_id) const { return get_stamp(record_id, 1); }
+
+    /**
+     * an INT column's values (or a dictionary-encoded column's codes), indexed by
+     * record id - 1 (size() of them)
+     */
+    const int32_t *int_values(uint column) const {
+        return (const int32_t *) (data() + minipage(column) + bitmap_size);
+    }
+
+    /**
+     * bytes of a TEXT column's value, borrowed from the block (or its dictionary)
+     */
+    RecordView text(RecordID record_id, uint column) const;
+
+    /**
+     * how many records a PaxPage gets for a layout: as many as fit if each TEXT
+     * value were AVERAGE_TEXT_SZ bytes
+     */
+    static u_int16_t capacity_for(const RowLayout &layout);
+
+    /**
+     * the largest record an empty PaxPage for a layout can take: its fixed part plus all the
+     * room left for text once the minipages are laid out
+     */
+    static u_int16_t max_record_size(const RowLayout &layout);
+
+    static const u_int16_t AVERAGE_TEXT_SZ = 16;
+
+protected:
+    static const u_int16_t HEADER_SZ = 8;
+    static const u_int16_t BITMAP_OFFSET = HEADER_SZ;
+
+    const RowLayout &layout;
+    u_int16_t num_records; // the number of record ids handed out
+    u_int16_t capacity; // the most records the block can hold
+    u_int16_t var_start; // first byte of text
+    u_int16_t fragmented; // text bytes held by deleted or replaced records, reclaimed by compact()
+    u_int16_t bitmap_size; // bytes per bitmap, padded to 4
+    u_int16_t fixed_end; // end of the last minipage
+    std::vector<char> scratch; // where view() reassembles records
+
+    char *data(void) const { return (char *) this->block.get_data(); }
+
+    /**
+     * offset of a column's minipage (its null bitmap)
+     */
+    u_int16_t minipage(uint column) const {
+        return BITMAP_OFFSET + 3 * bitmap_size + 2 * capacity * sizeof(Timestamp)
+               + column * (bitmap_size + capacity * sizeof(int32_t));
+    }
+
+    /**
+     * offset of a record's created (which = 0) or deleted (which = 1) stamp
+     */
+    u_int16_t stamp(RecordID record_id, uint which) const {
+        return BITMAP_OFFSET + 3 * bitmap_size + (which * capacity + record_id - 1) * sizeof(Timestamp);
+    }
+
+    Timestamp get_stamp(RecordID record_id, uint which) const {
+        Timestamp ts;
+        memcpy(&ts, data() + stamp(record_id, which), sizeof(ts));
+        return ts;
+    }
+
+    /**
+     * offset of a record's 4-byte slot in a column's minipage
+     */
+    u_int16_t slot(RecordID record_id, uint column) const {
+        return minipage(column) + bitmap_size + (record_id - 1) * sizeof(int32_t);
+    }
+
+    bool test_bit(u_int16_t offset, uint bit) const {
+        return (data()[offset + bit / 8] & (1 << (bit % 8))) != 0;
+    }
+
+    void set_bit(u_int16_t offset, uint bit, bool on);
+
+    void put_header(void);
+
+    /**
+     * does the column keep its bytes in the text area (a TEXT column that isn't dictionary-encoded)?
+     */
+    bool has_text(uint column) const { return has_text(layout, column); }
+
+    static bool has_text(const RowLayout &layout, uint column) {
+        return layout.get_data_type(column) == ColumnAttribute::DataType::TEXT
+               && layout.get_dictionary(column) == nullptr;
+    }
+
+    /**
+     * bytes of text in a record in RowLayout format
+     */
+    u_int16_t text_size(const Dbt &data) const { return data.get_size() - layout.get_fixed_size(); }
+
+    /**
+     * bytes of text held by a stored record
+     */
+    u_int16_t text_size(RecordID record_id) const;
+
+    /**
+     * scatter a record into the minipages, making it live (the text must fit contiguously)
+     */
+    void store(RecordID record_id, const Dbt &data);
+
+    /**
+     * record id for add(): the next unused one, else the first deleted one, else 0
+     */
+    RecordID free_slot(void) const;
+};
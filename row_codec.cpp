@@ -0,0 +1,185 @@
+/**
+ * @file row_codec.cpp - Row and RowLayout implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include <cstring>
+#include "row_codec.h"
+
+RowLayout::RowLayout(const ColumnAttributes &column_attributes) {
+    uint offset = (column_attributes.size() + FLAG_BITS + 7) / 8;
+    this->stamps = offset;
+    offset += 2 * sizeof(Timestamp);
+    for (ColumnAttribute ca: column_attributes) {
+        ColumnAttribute::DataType data_type = ca.get_data_type();
+        if (data_type != ColumnAttribute::DataType::INT && data_type != ColumnAttribute::DataType::TEXT)
+            throw DbRelationError("Only know how to marshal INT and TEXT");
+        this->data_types.push_back(data_type);
+        this->offsets.push_back(offset);
+        this->dictionaries.push_back(nullptr);
+        offset += data_type == ColumnAttribute::DataType::INT ? sizeof(int32_t) : 2 * sizeof(u_int16_t);
+    }
+    if (offset > DbBlock::BLOCK_SZ)
+        throw DbRelationError("too many columns to fit a row in a block");
+    this->fixed_end = offset;
+    this->max_size = DbBlock::BLOCK_SZ;
+}
+
+void RowLayout::set_max_size(u_int16_t size) {
+    if (this->fixed_end > size)
+        throw DbRelationError("too many columns to fit a row in a block");
+    this->max_size = size;
+}
+
+void RowLayout::set_dictionary(uint column, TextDictionary *dictionary) {
+    if (this->data_types[column] != ColumnAttribute::DataType::TEXT)
+        throw DbRelationError("only TEXT columns can be dictionary-encoded");
+    // a code takes the same 4 bytes as an offset and length, so no offsets move
+    this->dictionaries[column] = dictionary;
+}
+
+u_int16_t RowLayout::encode(const Row &row, char *bytes) const {
+    if (row.size() != size())
+        throw DbRelationError("expected " + std::to_string(size()) + " columns");
+    u_int16_t end = start(bytes);
+    for (uint column = 0; column < size(); column++) {
+        if (row.is_null(column))
+            continue;
+        const Value &value = row[column];
+        if (value.data_type != this->data_types[column])
+            throw DbRelationError("wrong type of value for column " + std::to_string(column));
+        if (value.data_type == ColumnAttribute::DataType::INT)
+            put_int(bytes, column, value.n);
+        else
+            put_text(bytes, column, value.text_data(), value.text_size(), end);
+    }
+    return end;
+}
+
+void RowLayout::decode(const RecordView &record, Row &row, bool borrow) const {
+    row.resize(size());
+    for (uint column = 0; column < size(); column++) {
+        bool null = is_null(record, column);
+        row.set_null(column, null);
+        if (null)
+            row[column] = this->data_types[column] == ColumnAttribute::DataType::INT ? Value() : Value("");
+        else
+            get(record, column, row[column], borrow);
+    }
+}
+
+u_int16_t RowLayout::start(char *bytes) const {
+    // every column is null until it is put, and the flags are off
+    uint bitmap_end = (size() + FLAG_BITS + 7) / 8;
+    memset(bytes, 0xff, bitmap_end);
+    memset(bytes + bitmap_end, 0, this->fixed_end - bitmap_end);
+    set_bit(bytes, size() + STUB_BIT, false);
+    set_bit(bytes, size() + MOVED_BIT, false);
+    return this->fixed_end;
+}
+
+u_int16_t RowLayout::encode_stub(Handle target, char *bytes) const {
+    u_int16_t end = start(bytes);
+    set_bit(bytes, size() + STUB_BIT, true);
+    u_int32_t n = pack(target);
+    memcpy(bytes + this->offsets[0], &n, sizeof(n));
+    return end;
+}
+
+Handle RowLayout::get_stub(const RecordView &record) const {
+    u_int32_t n;
+    memcpy(&n, record.data + this->offsets[0], sizeof(n));
+    return unpack(n);
+}
+
+void RowLayout::set_moved(char *bytes, bool moved) const {
+    set_bit(bytes, size() + MOVED_BIT, moved);
+}
+
+Timestamp RowLayout::get_created(const RecordView &record) const {
+    Timestamp ts;
+    memcpy(&ts, record.data + this->stamps, sizeof(ts));
+    return ts;
+}
+
+Timestamp RowLayout::get_deleted(const RecordView &record) const {
+    Timestamp ts;
+    memcpy(&ts, record.data + this->stamps + sizeof(Timestamp), sizeof(ts));
+    return ts;
+}
+
+void RowLayout::set_created(char *bytes, Timestamp ts) const {
+    memcpy(bytes + this->stamps, &ts, sizeof(ts));
+}
+
+void RowLayout::set_deleted(char *bytes, Timestamp ts) const {
+    memcpy(bytes + this->stamps + sizeof(Timestamp), &ts, sizeof(ts));
+}
+
+u_int32_t RowLayout::pack(Handle handle) {
+    if (handle.first >= (1u << (32 - STUB_RECORD_BITS)) || handle.second >= (1u << STUB_RECORD_BITS))
+        throw DbRelationError("can't forward a row to block " + std::to_string(handle.first));
+    return (handle.first << STUB_RECORD_BITS) | handle.second;
+}
+
+Handle RowLayout::unpack(u_int32_t n) {
+    return std::make_pair(n >> STUB_RECORD_BITS, (RecordID) (n & ((1u << STUB_RECORD_BITS) - 1)));
+}
+
+void RowLayout::put_int(char *bytes, uint column, int32_t n) const {
+    memcpy(bytes + this->offsets[column], &n, sizeof(int32_t));
+    set_null(bytes, column, false);
+}
+
+void RowLayout::put_text(char *bytes, uint column, const char *s, size_t size, u_int16_t &end) const {
+    if (this->dictionaries[column] != nullptr) {
+        put_int(bytes, column, this->dictionaries[column]->code(s, size));
+        return;
+    }
+    if (end + size > this->max_size)
+        throw DbRelationError("row too big: " + std::to_string(end + size) + " bytes, at most "
+                              + std::to_string(this->max_size) + " fit in a block");
+    u_int16_t slot[2] = {end, (u_int16_t) size};
+    memcpy(bytes + this->offsets[column], slot, sizeof(slot));
+    memcpy(bytes + end, s, size); // assume ascii for now
+    end += size;
+    set_null(bytes, column, false);
+}
+
+int32_t RowLayout::get_int(const RecordView &record, uint column) const {
+    int32_t n;
+    memcpy(&n, record.data + this->offsets[column], sizeof(int32_t));
+    return n;
+}
+
+RecordView RowLayout::get_text(const RecordView &record, uint column) const {
+    if (this->dictionaries[column] != nullptr)
+        return this->dictionaries[column]->value(get_int(record, column));
+    u_int16_t slot[2];
+    memcpy(slot, record.data + this->offsets[column], sizeof(slot));
+    return RecordView(record.data + slot[0], slot[1]);
+}
+
+void RowLayout::get(const RecordView &record, uint column, Value &value, bool borrow) const {
+    if (is_null(record, column))
+        return;
+    if (this->data_types[column] == ColumnAttribute::DataType::INT) {
+        value = Value(get_int(record, column));
+    } else {
+        RecordView text = get_text(record, column);
+        value = borrow ? Value::view(text.data, text.size) : Value(text.data, text.size);
+    }
+}
+
+void RowLayout::set_null(char *bytes, uint column, bool null) const {
+    set_bit(bytes, column, null);
+}
+
+void RowLayout::set_bit(char *bytes, uint bit, bool on) {
+    if (on)
+        bytes[bit / 8] |= (char) (1 << (bit % 8));
+    else
+        bytes[bit / 8] &= (char) ~(1 << (bit % 8));
+}
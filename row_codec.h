@@ -0,0 +1,236 @@
+/**
+ * @file row_codec.h - Flat row format for HeapTable records.
+ * Row
+ * RowLayout
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "snapshot.h"
+#include "text_dictionary.h"
+
+/**
+ * @class Row - one row's values, addressed by column number (the column's place in the table)
+ */
+class Row {
+public:
+    Row() {}
+
+    explicit Row(uint columns) : values(columns), nulls(columns, false) {}
+
+    /**
+     * number of columns
+     */
+    uint size() const { return (uint) values.size(); }
+
+    /**
+     * change the number of columns (new ones are non-null 0)
+     */
+    void resize(uint columns) {
+        values.resize(columns);
+        nulls.resize(columns, false);
+    }
+
+    Value &operator[](uint column) { return values[column]; }
+
+    const Value &operator[](uint column) const { return values[column]; }
+
+    bool is_null(uint column) const { return nulls[column]; }
+
+    void set_null(uint column, bool null = true) { nulls[column] = null; }
+
+protected:
+    std::vector<Value> values;
+    std::vector<bool> nulls;
+};
+
+typedef std::vector<Row> Rows;
+
+/**
+ * @class RowLayout - a table's record format, worked out once from its column types.
+ *
+ *      A record is laid out as:
+            null bitmap: one bit per column, then the stub and moved flags, (columns + 9) / 8 bytes
+            version stamps: u32 timestamps of when the row was created and when it was deleted
+                            or replaced (0 while it is current), see Snapshot
+            fixed section: one slot per column, in column order
+                INT: the 4-byte value
+                TEXT: u16 offset (from the start of the record) and u16 length of its bytes,
+                      or for a dictionary-encoded column (set_dictionary) its 4-byte code
+            variable section: the TEXT bytes
+        Every column's slot is at an offset known up front, so a field is read without
+        walking the fields before it, and nothing is looked up by name.
+        A row that outgrew its block on update is moved, and its old record becomes a stub
+        (encode_stub): every column null, the stub flag on, and where the row went packed into
+        the first column's slot. The moved record has the moved flag on.
+ */
+class RowLayout {
+public:
+    static const uint STUB_RECORD_BITS = 10; // of a packed stub target, the rest being its block id
+
+    RowLayout() : stamps(0), fixed_end(0), max_size(DbBlock::BLOCK_SZ) {}
+
+    explicit RowLayout(const ColumnAttributes &column_attributes);
+
+    /**
+     * number of columns
+     */
+    uint size() const { return (uint) data_types.size(); }
+
+    ColumnAttribute::DataType get_data_type(uint column) const { return data_types[column]; }
+
+    /**
+     * store a TEXT column as codes from a dictionary instead of its bytes.
+     * @param column the column
+     * @param dictionary its dictionary (must outlive the layout), nullptr to store the bytes
+     */
+    void set_dictionary(uint column, TextDictionary *dictionary);
+
+    /**
+     * the column's dictionary, nullptr if it isn't dictionary-encoded
+     */
+    TextDictionary *get_dictionary(uint column) const { return dictionaries[column]; }
+
+    /**
+     * size of a record with no TEXT bytes (the null bitmap, version stamps and fixed section)
+     */
+    u_int16_t get_fixed_size() const { return fixed_end; }
+
+    /**
+     * limit the size of a record to what an empty block of the table's page type can hold
+     * (e.g. SlottedPage::MAX_RECORD_SZ), so a bigger row fails to encode instead of failing to fit.
+     * @param size largest record, BLOCK_SZ until set
+     * @throws DbRelationError if even a row without TEXT bytes would be bigger
+     */
+    void set_max_size(u_int16_t size);
+
+    u_int16_t get_max_size() const { return max_size; }
+
+    /**
+     * marshal a whole row.
+     * @param row the values, one per column
+     * @param bytes where to marshal to (DbBlock::BLOCK_SZ bytes)
+     * @return size of the record
+     * @throws DbRelationError if a value has the wrong type or the record won't fit in a block
+     */
+    u_int16_t encode(const Row &row, char *bytes) const;
+
+    /**
+     * unmarshal a whole row.
+     * @param record marshaled record
+     * @param row set to its values
+     * @param borrow TEXT values view the record's bytes instead of copying them, so the row
+     *               must not outlive the record (or be copied, which makes it own them again)
+     */
+    void decode(const RecordView &record, Row &row, bool borrow = false) const;
+
+    /**
+     * start marshaling a record field by field (all columns start out as null).
+     * @param bytes where to marshal to (DbBlock::BLOCK_SZ bytes)
+     * @return where the variable section starts, to pass to put_text
+     */
+    u_int16_t start(char *bytes) const;
+
+    void put_int(char *bytes, uint column, int32_t n) const;
+
+    /**
+     * put a TEXT value (or, for a dictionary-encoded column, its code)
+     * @param end end of the record so far, moved past the text
+     * @throws DbRelationError if the record won't fit in a block
+     */
+    void put_text(char *bytes, uint column, const char *s, size_t size, u_int16_t &end) const;
+
+    bool is_null(const RecordView &record, uint column) const {
+        return (record.data[column / 8] & (1 << (column % 8))) != 0;
+    }
+
+    /**
+     * is the record a forwarding stub (see encode_stub)?
+     */
+    bool is_stub(const RecordView &record) const { return test_bit(record, size() + STUB_BIT); }
+
+    /**
+     * is the record a row moved here from the stub that forwards to it?
+     */
+    bool is_moved(const RecordView &record) const { return test_bit(record, size() + MOVED_BIT); }
+
+    /**
+     * marshal a forwarding stub, as small as a record gets.
+     * @param target where the row is now
+     * @param bytes where to marshal to (DbBlock::BLOCK_SZ bytes)
+     * @return size of the stub
+     * @throws DbRelationError if the target can't be packed into 4 bytes
+     */
+    u_int16_t encode_stub(Handle target, char *bytes) const;
+
+    /**
+     * where a stub's row is now
+     */
+    Handle get_stub(const RecordView &record) const;
+
+    /**
+     * flag a marshaled record as moved (or not)
+     */
+    void set_moved(char *bytes, bool moved) const;
+
+    Timestamp get_created(const RecordView &record) const;
+
+    Timestamp get_deleted(const RecordView &record) const;
+
+    void set_created(char *bytes, Timestamp ts) const;
+
+    void set_deleted(char *bytes, Timestamp ts) const;
+
+    /**
+     * a stub target in 4 bytes: block id in the high bits, record id in the low STUB_RECORD_BITS
+     * (a block never holds that many records)
+     * @throws DbRelationError if it doesn't fit
+     */
+    static u_int32_t pack(Handle handle);
+
+    static Handle unpack(u_int32_t n);
+
+    /**
+     * value of an INT column (or code of a dictionary-encoded column), read in place
+     */
+    int32_t get_int(const RecordView &record, uint column) const;
+
+    /**
+     * bytes of a TEXT column, borrowed from the record (or its dictionary)
+     */
+    RecordView get_text(const RecordView &record, uint column) const;
+
+    /**
+     * unmarshal one field.
+     * @param record marshaled record
+     * @param column which field
+     * @param value set to its value (left alone if it is null)
+     * @param borrow a TEXT value views the record's bytes instead of copying them
+     */
+    void get(const RecordView &record, uint column, Value &value, bool borrow = false) const;
+
+protected:
+    std::vector<ColumnAttribute::DataType> data_types;
+    std::vector<u_int16_t> offsets; // of each column's fixed slot
+    std::vector<TextDictionary *> dictionaries; // of each dictionary-encoded column, else nullptr
+    u_int16_t stamps; // offset of the version stamps
+    u_int16_t fixed_end; // where the variable section starts
+    u_int16_t max_size; // largest record the table's blocks can take
+
+    static const uint STUB_BIT = 0; // flags, after the columns' null bits
+    static const uint MOVED_BIT = 1;
+    static const uint FLAG_BITS = 2;
+
+    void set_null(char *bytes, uint column, bool null) const;
+
+    bool test_bit(const RecordView &record, uint bit) const {
+        return (record.data[bit / 8] & (1 << (bit % 8))) != 0;
+    }
+
+    static void set_bit(char *bytes, uint bit, bool on);
+};
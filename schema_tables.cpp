@@ -0,0 +1,410 @@
+/**
+ * @file schema_tables.cpp - Catalog tables implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include <algorithm>
+#include <sstream>
+#include "schema_tables.h"
+
+const Identifier Columns::TABLE_NAME = "_columns";
+const Identifier Indices::TABLE_NAME = "_indices";
+const Identifier TableOptions::TABLE_NAME = "_table_options";
+const Identifier Statistics::TABLE_NAME = "_statistics";
+
+/**
+ * The open catalog and the user tables and indexes opened through it.
+ */
+static Columns *columns = nullptr;
+static Indices *indices = nullptr;
+static TableOptions *table_options = nullptr;
+static Statistics *statistics = nullptr;
+static std::map<Identifier, HeapTable *> table_cache;
+static std::map<Identifier, u_int32_t> saved_stats; // stats version of each cached table when last recorded
+static std::map<std::pair<Identifier, Identifier>, DbIndex *> index_cache; // by table and index name
+
+static ColumnNames columns_column_names() {
+    ColumnNames column_names;
+    column_names.push_back("table_name");
+    column_names.push_back("column_name");
+    column_names.push_back("data_type");
+    return column_names;
+}
+
+static ColumnAttributes columns_column_attributes() {
+    return ColumnAttributes(3, ColumnAttribute(ColumnAttribute::TEXT));
+}
+
+static ColumnNames indices_column_names() {
+    ColumnNames column_names;
+    column_names.push_back("table_name");
+    column_names.push_back("index_name");
+    column_names.push_back("column_name");
+    column_names.push_back("seq_in_index");
+    column_names.push_back("index_type");
+    return column_names;
+}
+
+static ColumnAttributes indices_column_attributes() {
+    ColumnAttributes column_attributes(5, ColumnAttribute(ColumnAttribute::TEXT));
+    column_attributes[3] = ColumnAttribute(ColumnAttribute::INT);
+    return column_attributes;
+}
+
+static ColumnNames table_options_column_names() {
+    ColumnNames column_names;
+    column_names.push_back("table_name");
+    column_names.push_back("option_name");
+    column_names.push_back("option_value");
+    return column_names;
+}
+
+static ColumnAttributes table_options_column_attributes() {
+    return ColumnAttributes(3, ColumnAttribute(ColumnAttribute::TEXT));
+}
+
+static ColumnNames statistics_column_names() {
+    ColumnNames column_names;
+    column_names.push_back("table_name");
+    column_names.push_back("column_name");
+    column_names.push_back("row_count");
+    column_names.push_back("null_count");
+    column_names.push_back("ndv");
+    column_names.push_back("min_value");
+    column_names.push_back("max_value");
+    column_names.push_back("histogram");
+    return column_names;
+}
+
+static ColumnAttributes statistics_column_attributes() {
+    ColumnAttributes column_attributes(8, ColumnAttribute(ColumnAttribute::TEXT));
+    column_attributes[2] = ColumnAttribute(ColumnAttribute::INT);
+    column_attributes[3] = ColumnAttribute(ColumnAttribute::INT);
+    column_attributes[4] = ColumnAttribute(ColumnAttribute::INT);
+    return column_attributes;
+}
+
+// counts are INT columns in the catalog
+static int32_t clamp_count(u_int64_t n) {
+    return (int32_t) std::min(n, (u_int64_t) 0x7fffffff);
+}
+
+// an index object of the given type (not yet created or opened)
+static DbIndex *make_index(HeapTable &table, Identifier index_name, const ColumnNames &key_columns,
+                           Identifier index_type) {
+    if (index_type == "BTREE")
+        return new BTreeIndex(table, index_name, key_columns);
+    if (index_type == "HASH")
+        return new HashIndex(table, index_name, key_columns);
+    throw DbRelationError("unknown index type " + index_type);
+}
+
+/* -------------Columns::HeapTable-------------*/
+Columns::Columns() : HeapTable(TABLE_NAME, columns_column_names(), columns_column_attributes()) {}
+
+void Columns::add_table(Identifier table_name, const ColumnNames &column_names,
+                        const ColumnAttributes &column_attributes) {
+    for (uint i = 0; i < column_names.size(); i++) {
+        ValueDict row;
+        row["table_name"] = Value(table_name);
+        row["column_name"] = Value(column_names[i]);
+        ColumnAttribute ca = column_attributes[i];
+        row["data_type"] = Value(ca.get_data_type() == ColumnAttribute::INT ? "INT" : "TEXT");
+        this->insert(&row);
+    }
+}
+
+bool Columns::get_columns(Identifier table_name, ColumnNames &column_names, ColumnAttributes &column_attributes) {
+    column_names.clear();
+    column_attributes.clear();
+    DbRelationCursor *cursor = this->scan();
+    Handle handle;
+    while (cursor->next(handle)) {
+        ValueDict *row = this->project(handle);
+        if ((*row)["table_name"].get_text() == table_name) {
+            column_names.push_back((*row)["column_name"].get_text());
+            column_attributes.push_back(ColumnAttribute(
+                    (*row)["data_type"].get_text() == "INT" ? ColumnAttribute::INT : ColumnAttribute::TEXT));
+        }
+        delete row;
+    }
+    delete cursor;
+    return !column_names.empty();
+}
+
+/* -------------Indices::HeapTable-------------*/
+Indices::Indices() : HeapTable(TABLE_NAME, indices_column_names(), indices_column_attributes()) {}
+
+void Indices::add_index(Identifier table_name, Identifier index_name, const ColumnNames &key_columns,
+                        Identifier index_type) {
+    for (uint i = 0; i < key_columns.size(); i++) {
+        ValueDict row;
+        row["table_name"] = Value(table_name);
+        row["index_name"] = Value(index_name);
+        row["column_name"] = Value(key_columns[i]);
+        row["seq_in_index"] = Value((int32_t) i + 1);
+        row["index_type"] = Value(index_type);
+        this->insert(&row);
+    }
+}
+
+void Indices::get_indices(Identifier table_name, std::vector<Identifier> &index_names,
+                          std::vector<ColumnNames> &key_columns, std::vector<Identifier> &index_types) {
+    index_names.clear();
+    key_columns.clear();
+    index_types.clear();
+    ValueDict where;
+    where["table_name"] = Value(table_name);
+    Handles *handles = this->select(&where);
+    for (auto const& handle: *handles) {
+        ValueDict *row = this->project(handle);
+        Identifier index_name = (*row)["index_name"].get_text();
+        uint i = std::find(index_names.begin(), index_names.end(), index_name) - index_names.begin();
+        if (i == index_names.size()) {
+            index_names.push_back(index_name);
+            key_columns.push_back(ColumnNames());
+            index_types.push_back((*row)["index_type"].get_text());
+        }
+        // rows are in key order unless the catalog was edited by hand; place by seq_in_index anyway
+        uint seq = (uint) (*row)["seq_in_index"].n;
+        if (key_columns[i].size() < seq)
+            key_columns[i].resize(seq);
+        key_columns[i][seq - 1] = (*row)["column_name"].get_text();
+        delete row;
+    }
+    delete handles;
+}
+
+/* -------------TableOptions::HeapTable-------------*/
+TableOptions::TableOptions()
+    : HeapTable(TABLE_NAME, table_options_column_names(), table_options_column_attributes()) {}
+
+void TableOptions::add_options(Identifier table_name, const HeapTableOptions &options) {
+    for (auto const& option: options.get_all()) {
+        ValueDict row;
+        row["table_name"] = Value(table_name);
+        row["option_name"] = Value(option.first);
+        row["option_value"] = Value(option.second);
+        this->insert(&row);
+    }
+}
+
+void TableOptions::get_options(Identifier table_name, HeapTableOptions &options) {
+    ValueDict where;
+    where["table_name"] = Value(table_name);
+    Handles *handles = this->select(&where);
+    try {
+        for (auto const& handle: *handles) {
+            ValueDict *row = this->project(handle);
+            std::string name = (*row)["option_name"].get_text(), value = (*row)["option_value"].get_text();
+            delete row;
+            options.set(name, value);
+        }
+    } catch (...) {
+        delete handles;
+        throw;
+    }
+    delete handles;
+}
+
+/* -------------Statistics::HeapTable-------------*/
+Statistics::Statistics() : HeapTable(TABLE_NAME, statistics_column_names(), statistics_column_attributes()) {}
+
+void Statistics::save_stats(const DbRelation &table, const TableStats &stats) {
+    ValueDict where;
+    where["table_name"] = Value(table.get_table_name());
+    Handles *handles = this->select(&where);
+    for (auto const& handle: *handles)
+        this->del(handle);
+    delete handles;
+    const ColumnNames &column_names = table.get_column_names();
+    const ColumnAttributes &column_attributes = table.get_column_attributes();
+    for (uint i = 0; i < column_names.size(); i++) {
+        const ColumnStats &column = stats.columns[i];
+        ColumnAttribute ca = column_attributes[i];
+        bool is_int = ca.get_data_type() == ColumnAttribute::INT;
+        ValueDict row;
+        row["table_name"] = Value(table.get_table_name());
+        row["column_name"] = Value(column_names[i]);
+        row["row_count"] = Value(clamp_count(stats.row_count));
+        row["null_count"] = Value(clamp_count((u_int64_t) (column.null_frac * stats.row_count + 0.5)));
+        row["ndv"] = Value(clamp_count(column.ndv));
+        row["min_value"] = Value(!column.has_range ? "" : is_int ? std::to_string(column.min.n) : column.min.get_text());
+        row["max_value"] = Value(!column.has_range ? "" : is_int ? std::to_string(column.max.n) : column.max.get_text());
+        std::string histogram;
+        for (auto const& bound: column.histogram)
+            histogram += (histogram.empty() ? "" : " ") + std::to_string(bound);
+        row["histogram"] = Value(histogram);
+        this->insert(&row);
+    }
+}
+
+bool Statistics::get_stats(const DbRelation &table, TableStats &stats) {
+    const ColumnNames &column_names = table.get_column_names();
+    const ColumnAttributes &column_attributes = table.get_column_attributes();
+    stats = TableStats();
+    stats.columns.resize(column_names.size());
+    ValueDict where;
+    where["table_name"] = Value(table.get_table_name());
+    Handles *handles = this->select(&where);
+    uint found = 0;
+    for (auto const& handle: *handles) {
+        ValueDict *row = this->project(handle);
+        uint i = std::find(column_names.begin(), column_names.end(), (*row)["column_name"].get_text()) - column_names.begin();
+        if (i < column_names.size()) {
+            found++;
+            ColumnAttribute ca = column_attributes[i];
+            bool is_int = ca.get_data_type() == ColumnAttribute::INT;
+            ColumnStats &column = stats.columns[i];
+            stats.row_count = (u_int64_t) (*row)["row_count"].n;
+            column.null_frac = stats.row_count == 0 ? 0.0 : (double) (*row)["null_count"].n / stats.row_count;
+            column.ndv = (u_int64_t) (*row)["ndv"].n;
+            column.has_range = column.ndv > 0;
+            if (column.has_range) {
+                column.min = is_int ? Value((int32_t) std::stol((*row)["min_value"].get_text())) : Value((*row)["min_value"].get_text());
+                column.max = is_int ? Value((int32_t) std::stol((*row)["max_value"].get_text())) : Value((*row)["max_value"].get_text());
+            }
+            std::istringstream bounds((*row)["histogram"].get_text());
+            int32_t bound;
+            while (bounds >> bound)
+                column.histogram.push_back(bound);
+        }
+        delete row;
+    }
+    delete handles;
+    // a column added since (or a catalog edited by hand): better no statistics than half of them
+    return found == column_names.size();
+}
+
+/* -------------catalog functions-------------*/
+void initialize_schema_tables() {
+    if (columns == nullptr) {
+        columns = new Columns();
+        columns->create_if_not_exists();
+    }
+    if (indices == nullptr) {
+        indices = new Indices();
+        indices->create_if_not_exists();
+    }
+    if (table_options == nullptr) {
+        table_options = new TableOptions();
+        table_options->create_if_not_exists();
+    }
+    if (statistics == nullptr) {
+        statistics = new Statistics();
+        statistics->create_if_not_exists();
+    }
+}
+
+HeapTable *create_table(Identifier table_name, const ColumnNames &column_names,
+                        const ColumnAttributes &column_attributes, const HeapTableOptions &options) {
+    if (get_table(table_name) != nullptr)
+        throw DbRelationError("table " + table_name + " already exists");
+    HeapTable *table = new HeapTable(table_name, column_names, column_attributes, options);
+    try {
+        table->create();
+    } catch (...) {
+        delete table;
+        throw;
+    }
+    columns->add_table(table_name, column_names, column_attributes);
+    table_options->add_options(table_name, options);
+    table_cache[table_name] = table;
+    saved_stats[table_name] = table->get_stats_version();
+    return table;
+}
+
+HeapTable *get_table(Identifier table_name) {
+    auto cached = table_cache.find(table_name);
+    if (cached != table_cache.end())
+        return cached->second;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    if (!columns->get_columns(table_name, column_names, column_attributes))
+        return nullptr;
+    HeapTableOptions options;
+    table_options->get_options(table_name, options);
+    HeapTable *table = new HeapTable(table_name, column_names, column_attributes, options);
+    table->open();
+    table_cache[table_name] = table;
+    // its indexes have to be kept up to date from the first insert on
+    std::vector<Identifier> index_names, index_types;
+    std::vector<ColumnNames> key_columns;
+    indices->get_indices(table_name, index_names, key_columns, index_types);
+    for (uint i = 0; i < index_names.size(); i++) {
+        DbIndex *index = make_index(*table, index_names[i], key_columns[i], index_types[i]);
+        index->open();
+        table->add_index(index);
+        index_cache[std::make_pair(table_name, index_names[i])] = index;
+    }
+    TableStats stats;
+    if (statistics->get_stats(*table, stats))
+        table->set_stats(stats);
+    saved_stats[table_name] = table->get_stats_version();
+    return table;
+}
+
+DbIndex *create_index(Identifier table_name, Identifier index_name, const ColumnNames &key_columns,
+                      Identifier index_type) {
+    HeapTable *table = get_table(table_name);
+    if (table == nullptr)
+        throw DbRelationError("no such table " + table_name);
+    if (get_index(table_name, index_name) != nullptr)
+        throw DbRelationError("index " + index_name + " already exists on " + table_name);
+    DbIndex *index = make_index(*table, index_name, key_columns, index_type);
+    try {
+        index->create();
+    } catch (...) {
+        delete index;
+        throw;
+    }
+    indices->add_index(table_name, index_name, key_columns, index_type);
+    table->add_index(index);
+    index_cache[std::make_pair(table_name, index_name)] = index;
+    return index;
+}
+
+DbIndex *get_index(Identifier table_name, Identifier index_name) {
+    // opening the table opens all of its indexes
+    if (get_table(table_name) == nullptr)
+        return nullptr;
+    auto cached = index_cache.find(std::make_pair(table_name, index_name));
+    return cached != index_cache.end() ? cached->second : nullptr;
+}
+
+const TableStats &analyze_table(Identifier table_name) {
+    HeapTable *table = get_table(table_name);
+    if (table == nullptr)
+        throw DbRelationError("no such table " + table_name);
+    const TableStats &stats = table->analyze();
+    statistics->save_stats(*table, stats);
+    saved_stats[table_name] = table->get_stats_version();
+    return stats;
+}
+
+void close_schema_tables() {
+    // statistics the tables brought up to date with their inserts since they were recorded
+    for (auto &entry: table_cache) {
+        const TableStats *stats = entry.second->get_stats();
+        if (stats != nullptr && entry.second->get_stats_version() != saved_stats[entry.first])
+            statistics->save_stats(*entry.second, *stats);
+    }
+    saved_stats.clear();
+    // indexes read their tables as they close, so they go first
+    for (auto &entry: index_cache)
+        delete entry.second;
+    index_cache.clear();
+    for (auto &entry: table_cache)
+        delete entry.second;
+    table_cache.clear();
+    delete table_options;
+    table_options = nullptr;
+    delete statistics;
+    statistics = nullptr;
+    delete indices;
+    indices = nullptr;
+    delete columns;
+    columns = nullptr;
+}
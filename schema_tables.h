@@ -0,0 +1,212 @@
+/**
+ * @file schema_tables.h - Catalog of the tables created through the SQL shell.
+ * Columns: HeapTable
+ * Indices: HeapTable
+ * TableOptions: HeapTable
+ * Statistics: HeapTable
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include "heap_storage.h"
+#include "btree.h"
+#include "hash_index.h"
+
+/**
+ * @class Columns - the _columns catalog table
+ *
+ *      One row per column of every user table, in column order:
+ *          _columns(table_name TEXT, column_name TEXT, data_type TEXT)
+ *      A table exists as far as the shell is concerned when it has rows here.
+ */
+class Columns : public HeapTable {
+public:
+    static const Identifier TABLE_NAME; // "_columns"
+
+    Columns();
+
+    virtual ~Columns() {}
+
+    /**
+     * record a new table's columns
+     * @param table_name the new table
+     * @param column_names its columns, in order
+     * @param column_attributes their types
+     */
+    virtual void add_table(Identifier table_name, const ColumnNames &column_names,
+                           const ColumnAttributes &column_attributes);
+
+    /**
+     * look up a table's columns
+     * @param table_name which table
+     * @param column_names filled in with its columns, in order
+     * @param column_attributes filled in with their types
+     * @return false if the table is not in the catalog
+     */
+    virtual bool get_columns(Identifier table_name, ColumnNames &column_names, ColumnAttributes &column_attributes);
+};
+
+/**
+ * @class Indices - the _indices catalog table
+ *
+ *      One row per key column of every index, in key order:
+ *          _indices(table_name TEXT, index_name TEXT, column_name TEXT, seq_in_index INT, index_type TEXT)
+ */
+class Indices : public HeapTable {
+public:
+    static const Identifier TABLE_NAME; // "_indices"
+
+    Indices();
+
+    virtual ~Indices() {}
+
+    /**
+     * record a new index
+     * @param table_name the indexed table
+     * @param index_name the new index
+     * @param key_columns its key columns, in order
+     * @param index_type e.g. "BTREE"
+     */
+    virtual void add_index(Identifier table_name, Identifier index_name, const ColumnNames &key_columns,
+                           Identifier index_type);
+
+    /**
+     * look up the indexes on a table
+     * @param table_name which table
+     * @param index_names filled in with its indexes' names
+     * @param key_columns filled in with each one's key columns, in order
+     * @param index_types filled in with each one's type
+     */
+    virtual void get_indices(Identifier table_name, std::vector<Identifier> &index_names,
+                             std::vector<ColumnNames> &key_columns, std::vector<Identifier> &index_types);
+};
+
+/**
+ * @class TableOptions - the _table_options catalog table
+ *
+ *      One row per option of every user table, as HeapTableOptions::get_all() gives them:
+ *          _table_options(table_name TEXT, option_name TEXT, option_value TEXT)
+ *      A table without rows here (e.g. one from before options were recorded) has the defaults.
+ */
+class TableOptions : public HeapTable {
+public:
+    static const Identifier TABLE_NAME; // "_table_options"
+
+    TableOptions();
+
+    virtual ~TableOptions() {}
+
+    /**
+     * record a new table's options
+     * @param table_name the new table
+     * @param options its storage choices
+     */
+    virtual void add_options(Identifier table_name, const HeapTableOptions &options);
+
+    /**
+     * look up a table's options
+     * @param table_name which table
+     * @param options set to the recorded ones (left alone if there are none)
+     */
+    virtual void get_options(Identifier table_name, HeapTableOptions &options);
+};
+
+/**
+ * @class Statistics - the _statistics catalog table
+ *
+ *      One row per column of every analyzed table, in column order:
+ *          _statistics(table_name TEXT, column_name TEXT, row_count INT, null_count INT, ndv INT,
+ *                      min_value TEXT, max_value TEXT, histogram TEXT)
+ *      An INT column's min_value and max_value are written in decimal, and its histogram as
+ *      the bucket bounds separated by spaces (see ColumnStats). min_value and max_value are
+ *      empty when every value is null (ndv is 0).
+ */
+class Statistics : public HeapTable {
+public:
+    static const Identifier TABLE_NAME; // "_statistics"
+
+    Statistics();
+
+    virtual ~Statistics() {}
+
+    /**
+     * record a table's statistics, replacing any recorded before
+     * @param table the analyzed table
+     * @param stats its statistics
+     */
+    virtual void save_stats(const DbRelation &table, const TableStats &stats);
+
+    /**
+     * look up a table's statistics
+     * @param table which table
+     * @param stats filled in with its statistics
+     * @return false if the table was never analyzed
+     */
+    virtual bool get_stats(const DbRelation &table, TableStats &stats);
+};
+
+/**
+ * Open (creating on first use) the catalog tables. Call once the DbEnv is open.
+ */
+void initialize_schema_tables();
+
+/**
+ * Create a user table and record it in the catalog.
+ * @param table_name the new table
+ * @param column_names its columns, in order
+ * @param column_attributes their types
+ * @param options its storage choices, recorded so the table is always opened with them
+ * @return the open table (owned by the catalog)
+ * @throws DbRelationError if the table already exists or the options don't fit its columns
+ */
+HeapTable *create_table(Identifier table_name, const ColumnNames &column_names,
+                        const ColumnAttributes &column_attributes,
+                        const HeapTableOptions &options = HeapTableOptions());
+
+/**
+ * Get an open user table by name; tables are opened once and kept in a cache.
+ * @param table_name which table
+ * @return the open table (owned by the catalog), or nullptr if there is no such table
+ */
+HeapTable *get_table(Identifier table_name);
+
+/**
+ * Create an index on a user table, fill it from the rows already there, and record it in the
+ * catalog. The table keeps it up to date from then on.
+ * @param table_name the table to index
+ * @param index_name the new index
+ * @param key_columns its key columns, in order
+ * @param index_type "BTREE" or "HASH"
+ * @return the open index (owned by the catalog)
+ * @throws DbRelationError if there is no such table or column, the index already exists,
+ *         or the type is unknown
+ */
+DbIndex *create_index(Identifier table_name, Identifier index_name, const ColumnNames &key_columns,
+                      Identifier index_type = "BTREE");
+
+/**
+ * Get an open index by name (its table is opened too).
+ * @param table_name the indexed table
+ * @param index_name which index
+ * @return the open index (owned by the catalog), or nullptr if there is no such index
+ */
+DbIndex *get_index(Identifier table_name, Identifier index_name);
+
+/**
+ * Gather a user table's statistics (ANALYZE) and record them in the catalog. From then on the
+ * table keeps them up to date as rows are inserted, and the catalog is brought up to date
+ * when it is closed.
+ * @param table_name the table to analyze
+ * @return its statistics (owned by the table)
+ * @throws DbRelationError if there is no such table
+ */
+const TableStats &analyze_table(Identifier table_name);
+
+/**
+ * Close every cached index and table and the catalog itself (before the DbEnv goes away),
+ * recording statistics that changed since they were loaded or analyzed.
+ */
+void close_schema_tables();
@@ -0,0 +1,73 @@
+/**
+ * @file snapshot.cpp - VersionClock implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include <fstream>
+#include <map>
+#include <mutex>
+#include "snapshot.h"
+
+/**
+ * The clock, shared by every table (and thread) in the process.
+ */
+static std::mutex clock_mutex;
+static bool clock_loaded = false;
+static Timestamp clock_now = 0; // last timestamp handed out
+static Timestamp clock_reserved = 0; // saved in _clock; timestamps up to here can be handed out
+static std::map<Timestamp, u_int32_t> snapshots_in_use; // how many snapshots at each timestamp
+
+static std::string clock_path() {
+    const char *home;
+    _DB_ENV->get_home(&home);
+    return std::string(home) + "/_clock";
+}
+
+// the first time through, start after anything a previous run could have handed out
+static void load_clock() {
+    if (clock_loaded)
+        return;
+    std::ifstream in(clock_path(), std::ios::binary);
+    if (!in.read((char *) &clock_reserved, sizeof(clock_reserved)))
+        clock_reserved = 0;
+    clock_now = clock_reserved;
+    clock_loaded = true;
+}
+
+Timestamp VersionClock::write_stamp(void) {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    load_clock();
+    if (clock_now == clock_reserved) {
+        clock_reserved += RESERVE_STEP;
+        std::ofstream out(clock_path(), std::ios::binary | std::ios::trunc);
+        out.write((const char *) &clock_reserved, sizeof(clock_reserved));
+    }
+    return ++clock_now;
+}
+
+Snapshot VersionClock::take(void) {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    load_clock();
+    snapshots_in_use[clock_now]++;
+    return Snapshot(clock_now);
+}
+
+void VersionClock::release(const Snapshot &snapshot) {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    auto found = snapshots_in_use.find(snapshot.ts);
+    if (found != snapshots_in_use.end() && --found->second == 0)
+        snapshots_in_use.erase(found);
+}
+
+Timestamp VersionClock::oldest(void) {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    load_clock();
+    return snapshots_in_use.empty() ? clock_now : snapshots_in_use.begin()->first;
+}
+
+bool VersionClock::in_use(void) {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    return !snapshots_in_use.empty();
+}
@@ -0,0 +1,74 @@
+/**
+ * @file snapshot.h - Timestamps for multi-version reads.
+ * Snapshot
+ * VersionClock
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include "storage_engine.h"
+
+typedef u_int32_t Timestamp;
+
+/**
+ * @class Snapshot - the database as it was at one moment, for a reader
+ *
+ *      Each write (an insert, update or delete, or a whole COPY) gets the next timestamp from
+        the VersionClock and is committed right away. A row version is stamped with when it was
+        created and when it was deleted or replaced (0 while it is current), and a snapshot
+        taken at ts sees the versions created at or before ts and not yet gone by then.
+ */
+class Snapshot {
+public:
+    static const Timestamp LATEST = 0xffffffff; // sees every committed version that is still current
+
+    Timestamp ts;
+
+    explicit Snapshot(Timestamp ts = LATEST) : ts(ts) {}
+
+    /**
+     * is a version with these stamps visible in this snapshot?
+     */
+    bool sees(Timestamp created, Timestamp deleted) const {
+        return created <= ts && (deleted == 0 || deleted > ts);
+    }
+};
+
+/**
+ * @class VersionClock - hands out write timestamps and snapshots for every table in the process
+ *
+ *      Snapshots are counted while in use, so writers can tell whether anyone could still need
+        the version they are about to replace (oldest()). The clock is saved in the environment's
+        home as _clock, reserving RESERVE_STEP timestamps at a time, so every stamp written before
+        a restart is older than the snapshots taken after it.
+ */
+class VersionClock {
+public:
+    static const Timestamp RESERVE_STEP = 1 << 16;
+
+    /**
+     * the timestamp for a write, after every one handed out so far
+     */
+    static Timestamp write_stamp(void);
+
+    /**
+     * a snapshot of everything written so far, in use until it is released
+     */
+    static Snapshot take(void);
+
+    static void release(const Snapshot &snapshot);
+
+    /**
+     * the oldest snapshot in use, or the last write's timestamp if there are none: versions
+     * gone by then can't be seen by anyone
+     */
+    static Timestamp oldest(void);
+
+    /**
+     * is any snapshot in use (e.g. by an open cursor)?
+     */
+    static bool in_use(void);
+};
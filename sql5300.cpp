@@ -10,10 +10,13 @@
 #include <string.h>
 #include "db_cxx.h"
 #include <string>
+#include <fstream>
+#include <sstream>
 #include <sys/types.h>
 #include "SQLParser.h"
 #include "sqlhelper.h"
 #include "heap_storage.h"
+#include "schema_tables.h"
 
 #define SELECT hsql::StatementType::kStmtSelect
 #define CREATE hsql::StatementType::kStmtCreate
@@ -37,6 +40,56 @@ void handleSQLStatement(std::string query);
  */
 void printStatementInfo(const hsql::CreateStatement *statement);
 
+/**
+ * Executes CREATE TABLE: creates the heap table and records it in the catalog.
+ * @param statement CREATE TABLE statement
+ * @param options the table's storage choices
+ */
+void executeCreateTable(const hsql::CreateStatement *statement, const HeapTableOptions &options);
+
+/**
+ * Takes the storage options off the end of a CREATE TABLE statement, which the SQL parser does not know:
+ *      CREATE TABLE <table> (<columns>) [WITH (<option> = <value>, ...)]
+ * e.g. WITH (page_layout = PAX, backend = MMAP, dictionary_columns = b c); see HeapTableOptions::set
+ * @param query input line, left without the WITH clause
+ * @param options set from the clause
+ * @throws DbRelationError if an option is unknown or malformed
+ */
+void takeTableOptions(std::string &query, HeapTableOptions &options);
+
+/**
+ * Executes CREATE INDEX: builds the index over the table's rows and records it in the catalog.
+ * @param statement CREATE INDEX statement
+ * @param index_type "BTREE" or "HASH"
+ */
+void executeCreateIndex(const hsql::CreateStatement *statement, std::string index_type);
+
+/**
+ * Takes the index type off the end of a CREATE INDEX statement, which the SQL parser does not know:
+ *      CREATE INDEX <index> ON <table> (<columns>) [USING BTREE | USING HASH]
+ * @param query input line, left without the USING clause
+ * @return the index type, "BTREE" if none was given
+ */
+std::string takeIndexType(std::string &query);
+
+/**
+ * Handles the bulk loading command, which the SQL parser does not know:
+ *      COPY <table> FROM '<path>' [DELIMITER '<c>'] [HEADER]
+ * The delimiter defaults to a tab for .tsv files and a comma otherwise.
+ * @param query input line
+ * @return false if the input is not a COPY command (so it should be parsed as SQL)
+ */
+bool handleCopyCommand(std::string query);
+
+/**
+ * Handles the statistics command, which the SQL parser does not know:
+ *      ANALYZE <table>
+ * Samples the table's blocks, records per-column statistics in the catalog and prints them.
+ * @param query input line
+ * @return false if the input is not an ANALYZE command (so it should be parsed as SQL)
+ */
+bool handleAnalyzeCommand(std::string query);
+
 /**
  * Parses SQL statement and prints its query.
  * @param statement to be parsed
@@ -130,6 +183,7 @@ int main(int argc, char** argv) {
         exit(1);
     }
     _DB_ENV = &env;
+    initialize_schema_tables();
 
     // Parse the SQL strings
     std::string input; // input string
@@ -143,11 +197,20 @@ int main(int argc, char** argv) {
         }
         if (input == EXIT) { // EXIT condition
             std::cout << "Terminating the program" << std::endl;
+            close_schema_tables();
             break;
         }
         // Naive Test
         if (input == "test") {
             std::cout << "test_heap_storage: " << (test_heap_storage() ? "\nTests Passed" : "\nTests Failed") << std::endl;
+            std::cout << "test_btree_index: " << (test_btree_index() ? "\nTests Passed" : "\nTests Failed") << std::endl;
+            std::cout << "test_hash_index: " << (test_hash_index() ? "\nTests Passed" : "\nTests Failed") << std::endl;
+            continue;
+        }
+        if (handleCopyCommand(input)) {
+            continue;
+        }
+        if (handleAnalyzeCommand(input)) {
             continue;
         }
 
@@ -158,6 +221,14 @@ int main(int argc, char** argv) {
 }
 
 void handleSQLStatement(std::string query) {
+    std::string index_type = takeIndexType(query);
+    HeapTableOptions options;
+    try {
+        takeTableOptions(query, options);
+    } catch (DbRelationError &e) {
+        std::cout << "Error: " << e.what() << std::endl;
+        return;
+    }
     hsql::SQLParserResult* result = hsql::SQLParser::parseSQLString(query);
     if (!result->isValid()) { // invalid SQL
         std::cout << "Invalid SQL: " << query << std::endl;
@@ -177,6 +248,8 @@ void handleSQLStatement(std::string query) {
                 break;
             case CREATE:
                 printStatementInfo((const hsql::CreateStatement*)statement);
+                executeCreateTable((const hsql::CreateStatement*)statement, options);
+                executeCreateIndex((const hsql::CreateStatement*)statement, index_type);
                 break;
             default:
                 hsql::printStatementInfo(statement);
@@ -206,6 +279,18 @@ void printStatementInfo(const hsql::CreateStatement *statement) {
             std::cout << "UN-SUPPORTED CREATE TYPE ";
             break;
     }
+    if (statement->type == hsql::CreateStatement::kIndex) {
+        // CREATE INDEX <index> ON <table> (<columns>)
+        std::cout << statement->indexName << " ON " << statement->tableName << " (";
+        for (uint i = 0; i < statement->indexColumns->size(); ++i) {
+            if (i != 0) {
+                std::cout << ", ";
+            }
+            std::cout << statement->indexColumns->at(i);
+        }
+        std::cout << ")" << std::endl;
+        return;
+    }
     // Table Name
     std::cout << statement->tableName << " ";
 
@@ -221,6 +306,225 @@ void printStatementInfo(const hsql::CreateStatement *statement) {
     std::cout << ")" << std::endl;
 }
 
+void executeCreateTable(const hsql::CreateStatement *statement, const HeapTableOptions &options) {
+    if (statement->type != hsql::CreateStatement::kTable) {
+        return;
+    }
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    for (auto const& col: *statement->columns) {
+        column_names.push_back(col->name);
+        switch(col->type) {
+            case hsql::ColumnDefinition::INT:
+                column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+                break;
+            case hsql::ColumnDefinition::TEXT:
+                column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+                break;
+            default:
+                std::cout << "Only INT and TEXT columns are supported" << std::endl;
+                return;
+        }
+    }
+    try {
+        if (get_table(statement->tableName) != nullptr) {
+            if (!statement->ifNotExists) {
+                std::cout << "Table " << statement->tableName << " already exists" << std::endl;
+            }
+            return;
+        }
+        create_table(statement->tableName, column_names, column_attributes, options);
+        std::cout << "created " << statement->tableName << std::endl;
+    } catch (DbRelationError &e) {
+        std::cout << "Error: " << e.what() << std::endl;
+    }
+}
+
+void takeTableOptions(std::string &query, HeapTableOptions &options) {
+    std::string upper = query;
+    for (auto &c: upper) c = toupper(c);
+    size_t end = upper.find_last_not_of(" \t;");
+    if (upper.compare(0, 6, "CREATE") != 0 || upper.find(" TABLE ") == std::string::npos || end == std::string::npos
+        || upper[end] != ')') {
+        return;
+    }
+    size_t with_at = upper.rfind(" WITH ");
+    if (with_at == std::string::npos) {
+        return;
+    }
+    size_t open = upper.find_first_not_of(" \t", with_at + 6);
+    if (open == std::string::npos || upper[open] != '(') {
+        return;
+    }
+    std::istringstream list(query.substr(open + 1, end - open - 1));
+    std::string option;
+    while (std::getline(list, option, ',')) {
+        size_t equals = option.find('=');
+        if (equals == std::string::npos) {
+            throw DbRelationError("expected <option> = <value> in WITH, got " + option);
+        }
+        std::string name = option.substr(0, equals), value = option.substr(equals + 1);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t") + 1);
+        for (auto &c: name) c = tolower(c);
+        options.set(name, value);
+    }
+    query.erase(with_at);
+}
+
+void executeCreateIndex(const hsql::CreateStatement *statement, std::string index_type) {
+    if (statement->type != hsql::CreateStatement::kIndex) {
+        return;
+    }
+    ColumnNames key_columns;
+    for (auto const& col: *statement->indexColumns) {
+        key_columns.push_back(col);
+    }
+    try {
+        create_index(statement->tableName, statement->indexName, key_columns, index_type);
+        std::cout << "created index " << statement->indexName << std::endl;
+    } catch (DbRelationError &e) {
+        std::cout << "Error: " << e.what() << std::endl;
+    }
+}
+
+std::string takeIndexType(std::string &query) {
+    std::string upper = query;
+    for (auto &c: upper) c = toupper(c);
+    size_t end = upper.find_last_not_of(" \t;");
+    if (upper.compare(0, 6, "CREATE") != 0 || upper.find(" INDEX ") == std::string::npos || end == std::string::npos) {
+        return "BTREE";
+    }
+    upper.erase(end + 1);
+    size_t using_at = upper.rfind(" USING ");
+    if (using_at == std::string::npos) {
+        return "BTREE";
+    }
+    std::istringstream words(upper.substr(using_at + 7));
+    std::string index_type, rest;
+    words >> index_type >> rest;
+    if (index_type.empty() || !rest.empty()) {
+        return "BTREE";
+    }
+    query.erase(using_at);
+    return index_type;
+}
+
+bool handleCopyCommand(std::string query) {
+    // the closing ; is optional, as for SQL statements
+    size_t last = query.find_last_not_of(" \t\r\n;");
+    query.erase(last == std::string::npos ? 0 : last + 1);
+    std::istringstream words(query);
+    std::string command, table_name, from, path, option;
+    words >> command;
+    for (auto &c: command) c = toupper(c);
+    if (command != "COPY") {
+        return false;
+    }
+    words >> table_name >> from;
+    for (auto &c: from) c = toupper(c);
+    // the path is a quoted literal, so it may hold spaces (and '' for a quote)
+    bool quoted = false;
+    char c;
+    if (words >> c && c == '\'') {
+        while (!quoted && words.get(c)) {
+            if (c == '\'') {
+                quoted = words.peek() != '\'';
+                if (quoted)
+                    break;
+                words.get(); // '' is one quote
+            }
+            path += c;
+        }
+    }
+    if (table_name.empty() || from != "FROM" || !quoted || path.empty()) {
+        std::cout << "Usage: COPY <table> FROM '<path>' [DELIMITER '<c>'] [HEADER]" << std::endl;
+        return true;
+    }
+    bool tsv = path.size() > 4 && path.substr(path.size() - 4) == ".tsv";
+    char delimiter = tsv ? '\t' : ',';
+    bool header = false;
+    while (words >> option) {
+        for (auto &c: option) c = toupper(c);
+        if (option == "HEADER") {
+            header = true;
+        } else if (option == "DELIMITER" && words >> option && option.size() >= 3) {
+            delimiter = option == "'\\t'" ? '\t' : option[1];
+        } else {
+            std::cout << "Unknown COPY option " << option << std::endl;
+            return true;
+        }
+    }
+
+    HeapTable *table = get_table(table_name);
+    if (table == nullptr) {
+        std::cout << "No such table " << table_name << std::endl;
+        return true;
+    }
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cout << "Cannot read " << path << std::endl;
+        return true;
+    }
+    try {
+        u_int32_t rows = table->bulk_load(in, delimiter, header);
+        table->flush();
+        std::cout << "COPY " << rows << std::endl;
+    } catch (DbRelationError &e) {
+        std::cout << "Error: " << e.what() << std::endl;
+    } catch (DbBlockNoRoomError &e) {
+        std::cout << "Error: " << e.what() << std::endl;
+    }
+    return true;
+}
+
+bool handleAnalyzeCommand(std::string query) {
+    std::istringstream words(query);
+    std::string command, table_name, rest;
+    words >> command;
+    for (auto &c: command) c = toupper(c);
+    if (command != "ANALYZE") {
+        return false;
+    }
+    words >> table_name >> rest;
+    if (!table_name.empty() && table_name.back() == ';') {
+        table_name.pop_back();
+    }
+    if (table_name.empty() || !(rest.empty() || rest == ";")) {
+        std::cout << "Usage: ANALYZE <table>" << std::endl;
+        return true;
+    }
+
+    try {
+        const TableStats &stats = analyze_table(table_name);
+        HeapTable *table = get_table(table_name);
+        const ColumnNames &column_names = table->get_column_names();
+        std::cout << "ANALYZE " << table_name << ": " << stats.row_count << " rows" << std::endl;
+        for (uint i = 0; i < column_names.size(); i++) {
+            const ColumnStats &column = stats.columns[i];
+            ColumnAttribute ca = table->get_column_attributes()[i];
+            bool is_int = ca.get_data_type() == ColumnAttribute::INT;
+            std::cout << "  " << column_names[i] << ": null_frac " << column.null_frac << ", ndv " << column.ndv;
+            if (column.has_range) {
+                std::cout << ", min " << (is_int ? std::to_string(column.min.n) : column.min.get_text())
+                          << ", max " << (is_int ? std::to_string(column.max.n) : column.max.get_text());
+            }
+            if (is_int) {
+                std::cout << ", histogram";
+                for (auto const& bound: column.histogram) {
+                    std::cout << " " << bound;
+                }
+            }
+            std::cout << std::endl;
+        }
+    } catch (DbRelationError &e) {
+        std::cout << "Error: " << e.what() << std::endl;
+    }
+    return true;
+}
+
 void printStatementInfo(const hsql::SelectStatement *statement) {
     std::string selectStatement = "";
 
@@ -3,14 +3,17 @@
  * DbBlock
  * DbFile
  * DbRelation
+ * DbIndex
  *
  * @author Kevin Lundeen
  * @see "Seattle University, CPSC5300, Spring 2022"
  */
 #pragma once
 
+#include <cstring>
 #include <exception>
 #include <map>
+#include <string>
 #include <utility>
 #include <vector>
 #include "db_cxx.h"
@@ -31,6 +34,23 @@ typedef std::invalid_argument DbInvalidRowError;
 typedef std::invalid_argument DbRecordIdNotFound;
 typedef std::logic_error FailToRemoveDbfile;
 
+/**
+ * @class RecordView - borrowed window onto one record's bytes inside a block.
+ * Nothing is copied: the view points straight into the block's memory, so it
+ * is only valid while the owning DbBlock is held and the record is unchanged.
+ */
+class RecordView {
+public:
+    const char *data;
+    u_int16_t size;
+
+    RecordView() : data(nullptr), size(0) {}
+
+    RecordView(const char *data, u_int16_t size) : data(data), size(size) {}
+};
+
+class RecordIDIterator;
+
 /**
  * @class DbBlock - abstract base class for blocks in our database files
  * (DbBlock's belong to DbFile's.)
@@ -39,9 +59,13 @@ typedef std::logic_error FailToRemoveDbfile;
  * 	initialize_new()
  * 	add(data)
  * 	get(record_id)
+ * 	view(record_id)
  * 	put(record_id, data)
  * 	del(record_id)
  * 	ids()
+ * 	next_id(record_id)
+ * 	begin(), end()
+ * 	get_free_space()
  * Accessors:
  * 	get_block()
  * 	get_data()
@@ -81,6 +105,14 @@ public:
      */
     virtual Dbt *get(RecordID record_id) = 0;
 
+    /**
+     * Get a record from this block without copying it.
+     * @param record_id  which record to view
+     * @returns          pointer and length into this block's memory
+     *                   (valid only while the block is held)
+     */
+    virtual RecordView view(RecordID record_id) = 0;
+
     /**
      * Change the data stored for a record in this block.
      * @param record_id  which record to update
@@ -102,6 +134,33 @@ public:
      */
     virtual RecordIDs *ids() = 0;
 
+    /**
+     * Step to the next record in this block (excluding deleted ones) without building a list.
+     * @param record_id  the record we are on (0 to start from the beginning)
+     * @returns          the following record id, or 0 if there are no more
+     */
+    virtual RecordID next_id(RecordID record_id = 0) = 0;
+
+    /**
+     * Forward iteration over the record ids in this block, e.g. for (RecordID id : *block).
+     */
+    RecordIDIterator begin();
+
+    RecordIDIterator end();
+
+    /**
+     * How much more record data this block could take.
+     * @returns  number of bytes a new record could use (after reclaiming any dead space)
+     */
+    virtual u_int16_t get_free_space() = 0;
+
+    /**
+     * Give back the space deleted and shrunk records left behind, in one pass.
+     * Record ids stay the same.
+     * @returns  whether there was any to give back (and so the block changed)
+     */
+    virtual bool compact() { return false; }
+
     /**
      * Access the whole block's memory as a BerkeleyDB Dbt pointer.
      * @returns  Dbt used by this block
@@ -125,8 +184,72 @@ protected:
     BlockID block_id;
 };
 
+/**
+ * @class RecordIDIterator - forward iterator over the live record ids of a DbBlock
+ */
+class RecordIDIterator {
+public:
+    RecordIDIterator(DbBlock *block, RecordID record_id) : block(block), record_id(record_id) {}
+
+    RecordID operator*() const { return record_id; }
+
+    RecordIDIterator &operator++() {
+        record_id = block->next_id(record_id);
+        return *this;
+    }
+
+    bool operator==(const RecordIDIterator &other) const { return record_id == other.record_id; }
+
+    bool operator!=(const RecordIDIterator &other) const { return record_id != other.record_id; }
+
+protected:
+    DbBlock *block;
+    RecordID record_id;  // 0 once past the last record
+};
+
+inline RecordIDIterator DbBlock::begin() { return RecordIDIterator(this, next_id(0)); }
+
+inline RecordIDIterator DbBlock::end() { return RecordIDIterator(this, 0); }
+
 // convenience type alias
-typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an iterator at some point
+typedef std::vector<BlockID> BlockIDs;  // materialized list, prefer iterating a BlockIDRange
+
+/**
+ * @class BlockIDRange - the block ids first..last (inclusive), iterated without building a list
+ */
+class BlockIDRange {
+public:
+    class iterator {
+    public:
+        iterator(BlockID block_id) : block_id(block_id) {}
+
+        BlockID operator*() const { return block_id; }
+
+        iterator &operator++() {
+            ++block_id;
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return block_id == other.block_id; }
+
+        bool operator!=(const iterator &other) const { return block_id != other.block_id; }
+
+    protected:
+        BlockID block_id;
+    };
+
+    BlockIDRange(BlockID first, BlockID last) : first(first), stop(last >= first ? last + 1 : first) {}
+
+    iterator begin() const { return iterator(first); }
+
+    iterator end() const { return iterator(stop); }
+
+    u_int32_t size() const { return stop - first; }
+
+protected:
+    BlockID first;
+    BlockID stop;  // one past the last block id
+};
 
 /**
  * @class DbFile - abstract base class which represents a disk-based collection of DbBlocks
@@ -135,9 +258,12 @@ typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an
  * 	open()
  * 	close()
  * 	get_new()
+ * 	get_new(buffer)
  *	get(block_id)
+ *	get(block_id, buffer)
  *	put(block)
  *	block_ids()
+ *	blocks()
  */
 class DbFile {
 public:
@@ -172,6 +298,13 @@ public:
      */
     virtual DbBlock *get_new() = 0;
 
+    /**
+     * Add a new block for this file, built in memory the caller owns.
+     * @param buffer  DbBlock::BLOCK_SZ bytes the block will live in (must outlive it)
+     * @returns       the newly appended block (freed by caller)
+     */
+    virtual DbBlock *get_new(char *buffer) = 0;
+
     /**
      * Get a specific block in this file.
      * @param block_id  which block to get
@@ -179,6 +312,14 @@ public:
      */
     virtual DbBlock *get(BlockID block_id) = 0;
 
+    /**
+     * Get a specific block in this file, read into memory the caller owns.
+     * @param block_id  which block to get
+     * @param buffer    DbBlock::BLOCK_SZ bytes the block will live in (must outlive it)
+     * @returns         pointer to the DbBlock (freed by caller)
+     */
+    virtual DbBlock *get(BlockID block_id, char *buffer) = 0;
+
     /**
      * Write a block to this file (the block knows its BlockID)
      * @param block  block to write (overwrites existing block on disk)
@@ -186,12 +327,18 @@ public:
     virtual void put(DbBlock *block) = 0;
 
     /**
-     * Get a list of all the valid BlockID's in the file
-     * FIXME - not a good long-term approach, but we'll do this until we put in iterators
+     * Get a list of all the valid BlockID's in the file, built in memory (callers that only
+     * walk the blocks should iterate blocks() instead)
      * @returns  a pointer to vector of BlockIDs (freed by caller)
      */
     virtual BlockIDs *block_ids() = 0;
 
+    /**
+     * All the valid BlockID's in the file, as a range to iterate.
+     * @returns  the range of block ids
+     */
+    virtual BlockIDRange blocks() = 0;
+
 protected:
     std::string name;  // filename (or part of it)
 };
@@ -221,18 +368,154 @@ protected:
 
 /**
  * @class Value - holds value for a field
+ *
+ *      A tagged union: data_type says whether it holds the INT n or a TEXT. Text of up to
+        INLINE_SZ bytes is kept inside the Value, so short strings never allocate; longer text
+        goes on the heap. view() makes a TEXT that borrows its bytes from somewhere else (a
+        block, a record being decoded, another Value) and is only good while they are. Copying
+        a Value always copies its text, so a view never outlives its bytes by being copied into
+        a ValueDict; moving one hands over whatever it has (heap text included) without copying.
  */
 class Value {
 public:
+    static const u_int32_t INLINE_SZ = 16; // longest text kept inside the Value
+
     ColumnAttribute::DataType data_type;
-    int32_t n;
-    std::string s;
 
-    Value() : n(0) { data_type = ColumnAttribute::INT; }
+protected:
+    enum Storage {
+        INLINE, OWNED, BORROWED
+    };
+
+    u_int32_t length : 30; // bytes of text
+    u_int32_t storage : 2; // where the text is
+
+public:
+    union {
+        int32_t n; // the INT
+        char inline_text[INLINE_SZ]; // INLINE text (use text_data())
+        const char *text_ptr; // OWNED or BORROWED text (use text_data())
+    };
+
+    Value() : data_type(ColumnAttribute::INT), length(0), storage(INLINE) { n = 0; }
+
+    Value(int32_t n) : data_type(ColumnAttribute::INT), length(0), storage(INLINE) { this->n = n; }
+
+    Value(const std::string &s) : length(0), storage(INLINE) { set_text(s.data(), s.size()); }
+
+    Value(const char *s) : length(0), storage(INLINE) { set_text(s, strlen(s)); }
+
+    Value(const char *data, size_t size) : length(0), storage(INLINE) { set_text(data, size); }
+
+    Value(const Value &other) : length(0), storage(INLINE) { copy(other); }
+
+    Value(Value &&other) noexcept : length(0), storage(INLINE) { take(other); }
+
+    ~Value() { clear(); }
+
+    Value &operator=(const Value &other) {
+        if (this != &other) {
+            clear();
+            copy(other);
+        }
+        return *this;
+    }
+
+    Value &operator=(Value &&other) noexcept {
+        if (this != &other) {
+            clear();
+            take(other);
+        }
+        return *this;
+    }
+
+    /**
+     * a TEXT borrowing bytes that stay put for as long as it is used
+     */
+    static Value view(const char *data, size_t size) {
+        Value value;
+        value.data_type = ColumnAttribute::TEXT;
+        value.length = (u_int32_t) size;
+        value.storage = BORROWED;
+        value.text_ptr = data;
+        return value;
+    }
+
+    /**
+     * a Value borrowing another's text (an INT is simply copied)
+     */
+    static Value view(const Value &other) {
+        return other.data_type == ColumnAttribute::TEXT ? view(other.text_data(), other.text_size()) : other;
+    }
+
+    /**
+     * the TEXT's bytes (not null-terminated)
+     */
+    const char *text_data() const { return storage == INLINE ? inline_text : text_ptr; }
+
+    u_int32_t text_size() const { return length; }
 
-    Value(int32_t n) : n(n) { data_type = ColumnAttribute::INT; }
+    /**
+     * a copy of the TEXT as a string
+     */
+    std::string get_text() const { return std::string(text_data(), length); }
 
-    Value(std::string s) : n(0), s(s) { data_type = ColumnAttribute::TEXT; }
+    /**
+     * whether the text is borrowed (see view())
+     */
+    bool is_view() const { return storage == BORROWED; }
+
+    /**
+     * order of the TEXT and some bytes: bytewise, a proper prefix first (like std::string::compare)
+     */
+    int compare_text(const char *data, size_t size) const {
+        int comparison = memcmp(text_data(), data, length < size ? length : size);
+        if (comparison != 0)
+            return comparison;
+        return length < size ? -1 : length > size ? 1 : 0;
+    }
+
+    int compare_text(const Value &other) const { return compare_text(other.text_data(), other.length); }
+
+protected:
+    void set_text(const char *data, size_t size) {
+        this->data_type = ColumnAttribute::TEXT;
+        this->length = (u_int32_t) size;
+        if (size <= INLINE_SZ) {
+            this->storage = INLINE;
+            memcpy(this->inline_text, data, size);
+        } else {
+            char *bytes = new char[size];
+            memcpy(bytes, data, size);
+            this->storage = OWNED;
+            this->text_ptr = bytes;
+        }
+    }
+
+    void copy(const Value &other) {
+        if (other.data_type == ColumnAttribute::TEXT) {
+            set_text(other.text_data(), other.length);
+        } else {
+            this->data_type = other.data_type;
+            this->n = other.n;
+        }
+    }
+
+    void take(Value &other) {
+        this->data_type = other.data_type;
+        this->length = other.length;
+        this->storage = other.storage;
+        memcpy(this->inline_text, other.inline_text, INLINE_SZ);
+        other.length = 0;
+        other.storage = INLINE;
+    }
+
+    void clear() {
+        if (this->storage == OWNED)
+            delete[] this->text_ptr;
+        this->length = 0;
+        this->storage = INLINE;
+    }
 };
 
 // More type aliases
@@ -244,6 +527,25 @@ typedef std::vector<Handle> Handles;
 typedef std::map<Identifier, Value> ValueDict;
 
 
+/**
+ * @class Predicate - one comparison of a column with a constant, e.g. a >= 5
+ */
+class Predicate {
+public:
+    enum Op {
+        EQ, NE, LT, LE, GT, GE
+    };
+
+    Identifier column_name;
+    Op op;
+    Value value;
+
+    Predicate(Identifier column_name, Op op, Value value) : column_name(column_name), op(op), value(value) {}
+};
+
+typedef std::vector<Predicate> Predicates;  // all of them must hold (AND)
+
+
 /**
  * @class DbRelationError - generic exception class for DbRelation
  */
@@ -253,6 +555,24 @@ public:
 };
 
 
+/**
+ * @class DbRelationCursor - walks the rows of a relation one handle at a time
+ */
+class DbRelationCursor {
+public:
+    DbRelationCursor() {}
+
+    virtual ~DbRelationCursor() {}
+
+    /**
+     * Advance to the next qualifying row.
+     * @param handle  set to the row's handle
+     * @returns       false once there are no more rows
+     */
+    virtual bool next(Handle &handle) = 0;
+};
+
+
 /**
  * @class DbRelation - top-level object handling a physical database relation
  *
@@ -269,6 +589,8 @@ public:
  *	del(handle)
  *	select()
  *	select(where)
+ *	scan()
+ *	scan(where)
  *	project(handle)
  *	project(handle, column_names)
  */
@@ -347,6 +669,28 @@ public:
      */
     virtual Handles *select(const ValueDict *where) = 0;
 
+    /**
+     * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE <where>
+     * with comparisons other than equality.
+     * @param where  predicates that must all hold
+     * @returns      a pointer to a list of handles for qualifying rows (freed by caller)
+     */
+    virtual Handles *select(const Predicates *where) = 0;
+
+    /**
+     * Like select(), but handles are produced lazily as the cursor advances,
+     * so nothing is materialized for the whole table.
+     * @returns  a cursor over the handles of all rows (freed by caller)
+     */
+    virtual DbRelationCursor *scan() = 0;
+
+    /**
+     * Cursor version of select(where).
+     * @param where  predicates that must all hold
+     * @returns      a cursor over the handles of qualifying rows (freed by caller)
+     */
+    virtual DbRelationCursor *scan(const Predicates *where) = 0;
+
     /**
      * Return a sequence of all values for handle (SELECT *).
      * @param handle  row to get values from
@@ -363,9 +707,130 @@ public:
      */
     virtual ValueDict *project(Handle handle, const ColumnNames *column_names) = 0;
 
+    /**
+     * Accessor for table_name.
+     * @returns  table name
+     */
+    virtual const Identifier &get_table_name() const { return table_name; }
+
+    /**
+     * Accessor for column_names.
+     * @returns  column names, in order
+     */
+    virtual const ColumnNames &get_column_names() const { return column_names; }
+
+    /**
+     * Accessor for column_attributes.
+     * @returns  column attributes, in column order
+     */
+    virtual const ColumnAttributes &get_column_attributes() const { return column_attributes; }
+
 protected:
     Identifier table_name;
     ColumnNames column_names;
     ColumnAttributes column_attributes;
 };
 
+/**
+ * @class DbIndex - abstract base class for an index on some of a relation's columns
+ *
+ * Methods
+ *	create()
+ *	drop()
+ *	open()
+ *	close()
+ *	lookup(key_values)
+ *	range(min_key, max_key)
+ *	insert(handle)
+ *	del(handle)
+ * Accessors:
+ *	get_name()
+ *	get_key_columns()
+ *	is_ordered()
+ */
+class DbIndex {
+public:
+    /**
+     * ctor/dtor (subclasses should handle the big-5)
+     * @param relation     the relation being indexed (must outlive the index)
+     * @param name         the index's name (unique among the relation's indices)
+     * @param key_columns  columns making up the key, in key order
+     */
+    DbIndex(DbRelation &relation, Identifier name, ColumnNames key_columns)
+            : relation(relation), name(name), key_columns(key_columns) {}
+
+    virtual ~DbIndex() {}
+
+    /**
+     * Execute: CREATE INDEX <name> ON <relation> ( <key_columns> )
+     * Builds the index from the relation's current rows.
+     */
+    virtual void create() = 0;
+
+    /**
+     * Execute: DROP INDEX <name> ON <relation>
+     */
+    virtual void drop() = 0;
+
+    /**
+     * Open existing index.
+     * Enables: lookup, range, insert, del.
+     */
+    virtual void open() = 0;
+
+    /**
+     * Closes the index.
+     * Disables: lookup, range, insert, del.
+     */
+    virtual void close() = 0;
+
+    /**
+     * Find the rows with the given key.
+     * @param key_values  a value for each of the key columns
+     * @returns           handles of the matching rows (freed by caller)
+     */
+    virtual Handles *lookup(const ValueDict *key_values) = 0;
+
+    /**
+     * Find the rows with keys from min_key through max_key (only for ordered indices).
+     * @param min_key  lowest key wanted (inclusive), nullptr for no lower bound
+     * @param max_key  highest key wanted (inclusive), nullptr for no upper bound
+     * @returns        handles of the matching rows in key order (freed by caller)
+     */
+    virtual Handles *range(const ValueDict *min_key, const ValueDict *max_key) = 0;
+
+    /**
+     * Add a row to the index (the row must already be in the relation).
+     * @param handle  the new row
+     */
+    virtual void insert(Handle handle) = 0;
+
+    /**
+     * Check that a row can be added, before it goes into the relation (e.g. that its key isn't
+     * too long), so a row insert() would fail on never gets in. Any row can by default.
+     * @param row  the new row's values (null columns left out)
+     * @throws DbRelationError if insert() would fail for the row
+     */
+    virtual void check(const ValueDict *row) {}
+
+    /**
+     * Remove a row from the index (before it is removed from the relation).
+     * @param handle  the row going away
+     */
+    virtual void del(Handle handle) = 0;
+
+    virtual const Identifier &get_name() const { return name; }
+
+    virtual const ColumnNames &get_key_columns() const { return key_columns; }
+
+    /**
+     * Whether keys are kept in order, i.e. whether range() works.
+     */
+    virtual bool is_ordered() const = 0;
+
+protected:
+    DbRelation &relation;
+    Identifier name;
+    ColumnNames key_columns;
+};
+
@@ -0,0 +1,101 @@
+/**
+ * @file text_dictionary.cpp - TextDictionary implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include <fstream>
+#include "text_dictionary.h"
+
+int32_t TextDictionary::code(const char *s, size_t size) {
+    std::string key(s, size);
+    auto found = this->codes.find(key);
+    if (found != this->codes.end())
+        return found->second;
+    if (this->values.size() >= (size_t) INT32_MAX)
+        throw DbRelationError("text dictionary is full");
+    int32_t code = (int32_t) this->values.size();
+    if (this->log.is_open()) {
+        // on disk before the caller can put the code in a record
+        write_value(this->log, key);
+        this->log.flush();
+        if (!this->log)
+            throw DbRelationError("could not add to a text dictionary");
+    } else {
+        this->dirty = true;
+    }
+    this->values.push_back(key);
+    this->codes.insert(std::make_pair(key, code));
+    return code;
+}
+
+int32_t TextDictionary::find(const char *s, size_t size) const {
+    auto found = this->codes.find(std::string(s, size));
+    return found == this->codes.end() ? NOT_FOUND : found->second;
+}
+
+RecordView TextDictionary::value(int32_t code) const {
+    if (code < 0 || (size_t) code >= this->values.size())
+        throw DbRelationError("no text for dictionary code " + std::to_string(code));
+    const std::string &s = this->values[code];
+    return RecordView(s.data(), (u_int16_t) s.size());
+}
+
+void TextDictionary::clear(void) {
+    this->values.clear();
+    this->codes.clear();
+    // the file still has the old values, so nothing is appended to it until it is saved again
+    this->log.close();
+    this->dirty = true;
+}
+
+bool TextDictionary::load(const std::string &path) {
+    this->log.close();
+    this->values.clear();
+    this->codes.clear();
+    this->dirty = false;
+    std::ifstream in(path, std::ios::binary);
+    bool found = (bool) in;
+    bool torn = false;
+    std::string s;
+    u_int16_t size;
+    while (found && in.read((char *) &size, sizeof(size))) {
+        s.resize(size);
+        if (!in.read(&s[0], size)) {
+            torn = true;
+            break;
+        }
+        this->codes.insert(std::make_pair(s, (int32_t) this->values.size()));
+        this->values.push_back(s);
+    }
+    if (found && in.gcount() != 0 && !torn)
+        torn = true; // only part of the last length
+    in.close();
+    // a value cut short (or no file at all) means writing the file out again before appending
+    this->dirty = !found || torn;
+    save(path);
+    return found;
+}
+
+void TextDictionary::save(const std::string &path) {
+    if (this->dirty) {
+        this->log.close();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        for (auto const& s: this->values)
+            write_value(out, s);
+        out.close();
+        if (!out)
+            throw DbRelationError("could not write text dictionary " + path);
+        this->dirty = false;
+    }
+    if (!this->log.is_open())
+        this->log.open(path, std::ios::binary | std::ios::app);
+}
+
+// protected
+void TextDictionary::write_value(std::ostream &out, const std::string &s) {
+    u_int16_t size = (u_int16_t) s.size();
+    out.write((const char *) &size, sizeof(size));
+    out.write(s.data(), size);
+}
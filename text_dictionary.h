@@ -0,0 +1,92 @@
+/**
+ * @file text_dictionary.h - Dictionary encoding for TEXT columns.
+ * TextDictionary
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include "storage_engine.h"
+
+/**
+ * @class TextDictionary - the distinct values of one TEXT column, each given an integer code.
+ *
+ *      Records of a dictionary-encoded column hold the 4-byte code instead of the text, so a
+        value repeated a million times is stored once, and equality tests on the column are
+        integer compares. Codes are handed out in order of first appearance and never change.
+        Kept next to the table's file as <table>.<column>.dict: for each code in order a u16
+        length and the bytes. Once the dictionary is loaded (or saved), a new value is appended to
+        the file and flushed as it gets its code, before any record holding the code can reach the
+        table's file, so the blocks on disk can always be decoded even if the table isn't closed.
+ */
+class TextDictionary {
+public:
+    static const int32_t NOT_FOUND = -1;
+
+    TextDictionary() : dirty(false) {}
+
+    virtual ~TextDictionary() {}
+
+    TextDictionary(const TextDictionary &other) = delete;
+
+    TextDictionary &operator=(const TextDictionary &other) = delete;
+
+    /**
+     * the code for a value, giving it the next code if it is new
+     * @throws DbRelationError if the dictionary is full
+     */
+    virtual int32_t code(const char *s, size_t size);
+
+    /**
+     * the code for a value, without adding it
+     * @return the code, or NOT_FOUND
+     */
+    virtual int32_t find(const char *s, size_t size) const;
+
+    /**
+     * the value for a code, borrowed from the dictionary (it stays put as codes are added)
+     */
+    virtual RecordView value(int32_t code) const;
+
+    /**
+     * number of codes handed out
+     */
+    virtual u_int32_t size(void) const { return (u_int32_t) values.size(); }
+
+    /**
+     * forget all values (e.g. the table was truncated)
+     */
+    virtual void clear(void);
+
+    /**
+     * read the dictionary written by save() and appended to since, then keep appending new
+     * values to it (a value cut short by a crash is dropped; no record can hold its code)
+     * @param path file to read
+     * @return false if there is no saved dictionary
+     */
+    virtual bool load(const std::string &path);
+
+    /**
+     * write the dictionary out, if the file doesn't have all of its values (e.g. it was cleared),
+     * then keep appending new values to it
+     * @param path file to write
+     */
+    virtual void save(const std::string &path);
+
+protected:
+    std::deque<std::string> values; // by code (a deque so values never move)
+    std::unordered_map<std::string, int32_t> codes;
+    bool dirty; // has values the file doesn't
+    std::ofstream log; // the file new values are appended to, once loaded or saved
+
+    /**
+     * write one value the way the file holds it
+     */
+    static void write_value(std::ostream &out, const std::string &s);
+};
@@ -0,0 +1,64 @@
+/**
+ * @file vacuum.cpp - VacuumThread implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include <algorithm>
+#include "vacuum.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// a share has to leave some time to the queries and give the steps some
+static double clamp_share(double share) {
+    return std::min(1.0, std::max(0.001, share));
+}
+
+VacuumThread::VacuumThread(Step step, double share)
+    : step(step), share(clamp_share(share)), steps(0), stopping(false) {
+    // started last, once everything it reads is set
+    this->thread = std::thread([this] { this->run(); });
+}
+
+VacuumThread::~VacuumThread() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    this->thread.join();
+}
+
+void VacuumThread::set_share(double share) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->share = clamp_share(share);
+}
+
+u_int64_t VacuumThread::get_steps(void) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->steps;
+}
+
+// protected
+void VacuumThread::run(void) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!this->stopping) {
+        lock.unlock();
+        Clock::time_point start = Clock::now();
+        bool more;
+        try {
+            more = this->step();
+        } catch (...) {
+            // nothing to report it to; the next pass starts over
+            more = false;
+        }
+        std::chrono::duration<double> busy = Clock::now() - start;
+        lock.lock();
+        this->steps++;
+        std::chrono::duration<double> pause = std::chrono::milliseconds(IDLE_MS);
+        if (more)
+            pause = busy * ((1.0 - this->share) / this->share);
+        this->wake.wait_for(lock, pause, [this] { return this->stopping; });
+    }
+}
@@ -0,0 +1,73 @@
+/**
+ * @file vacuum.h - Background thread for a table's maintenance work.
+ * VacuumThread
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "storage_engine.h"
+
+/**
+ * @class VacuumThread - runs a maintenance step over and over, in the background, throttled
+ *
+ *      The work comes in small steps (e.g. HeapTable::vacuum_step, a few blocks at a time).
+        After each one the thread sleeps long enough that the time it spent working is no more
+        than its share of the time gone by: a step that took 2 ms at a share of 0.1 is followed
+        by 18 ms of sleep. Since a step's time is mostly its reads and writes, that also caps the
+        I/O it takes from queries. A step that reports nothing left to do (or that couldn't run
+        because the table was busy) is followed by IDLE_MS instead.
+ */
+class VacuumThread {
+public:
+    typedef std::function<bool(void)> Step;
+
+    static const uint IDLE_MS = 1000; // sleep once there is nothing to do
+
+    /**
+     * start the thread
+     * @param step one bounded piece of work, returning whether there is more to do right away
+     * @param share most of the time the steps may take, between 0 and 1
+     */
+    VacuumThread(Step step, double share);
+
+    // stops the thread (after the step in progress, if any)
+    virtual ~VacuumThread();
+
+    // not implemented
+    VacuumThread(const VacuumThread &other) = delete;
+
+    // not implemented
+    VacuumThread &operator=(const VacuumThread &other) = delete;
+
+    /**
+     * change the share of time the steps may take from now on
+     */
+    virtual void set_share(double share);
+
+    /**
+     * number of steps run so far
+     */
+    virtual u_int64_t get_steps(void);
+
+protected:
+    Step step;
+    double share;
+    u_int64_t steps;
+    bool stopping;
+    std::mutex mutex; // guards share, steps and stopping
+    std::condition_variable wake; // stopping
+    std::thread thread;
+
+    /**
+     * thread body: step, sleep, repeat until stopped
+     */
+    virtual void run(void);
+};
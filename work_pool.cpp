@@ -0,0 +1,97 @@
+/**
+ * @file work_pool.cpp - WorkStealingPool implementation
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ * This is free and unencumbered software released into the public domain.
+ */
+#include <algorithm>
+#include "work_pool.h"
+
+WorkStealingPool::WorkStealingPool(uint num_threads) : batch(0), pending(0), stopping(false) {
+    if (num_threads == 0)
+        num_threads = std::max(1U, std::thread::hardware_concurrency());
+    for (uint i = 0; i < num_threads; i++)
+        this->queues.emplace_back(new Queue);
+    for (uint i = 0; i < num_threads; i++)
+        this->threads.emplace_back([this, i] { this->work(i); });
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->start.notify_all();
+    for (auto &thread: this->threads)
+        thread.join();
+}
+
+void WorkStealingPool::run(std::vector<Task> &tasks) {
+    if (tasks.empty())
+        return;
+    std::unique_lock<std::mutex> lock(this->mutex);
+    // worker i gets tasks [i * n / size, (i + 1) * n / size)
+    size_t n = tasks.size();
+    for (uint i = 0; i < size(); i++) {
+        std::lock_guard<std::mutex> queue_lock(this->queues[i]->mutex);
+        for (size_t t = i * n / size(); t < (i + 1) * n / size(); t++)
+            this->queues[i]->tasks.push_back(&tasks[t]);
+    }
+    this->pending = n;
+    this->error = nullptr;
+    this->batch++;
+    this->start.notify_all();
+    this->finish.wait(lock, [this] { return this->pending == 0; });
+    if (this->error != nullptr)
+        std::rethrow_exception(this->error);
+}
+
+// protected
+void WorkStealingPool::work(uint i) {
+    u_int32_t done_with = 0; // last batch this worker ran out of tasks in
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->start.wait(lock, [this, done_with] { return this->stopping || this->batch != done_with; });
+            if (this->stopping)
+                return;
+            done_with = this->batch;
+        }
+        for (Task *task = next_task(i); task != nullptr; task = next_task(i)) {
+            std::exception_ptr thrown;
+            try {
+                (*task)();
+            } catch (...) {
+                thrown = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (thrown != nullptr && this->error == nullptr)
+                this->error = thrown;
+            if (--this->pending == 0)
+                this->finish.notify_all();
+        }
+    }
+}
+
+WorkStealingPool::Task *WorkStealingPool::next_task(uint i) {
+    {
+        Queue &own = *this->queues[i];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            Task *task = own.tasks.front();
+            own.tasks.pop_front();
+            return task;
+        }
+    }
+    for (uint k = 1; k < size(); k++) {
+        Queue &victim = *this->queues[(i + k) % size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            Task *task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return task;
+        }
+    }
+    return nullptr;
+}
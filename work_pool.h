@@ -0,0 +1,87 @@
+/**
+ * @file work_pool.h - Worker threads for splitting a job into independent tasks.
+ * WorkStealingPool
+ *
+ * @author Ana Carolina de Souza Mendes, MSCS
+ * @author Fangsheng Xu, MSCS
+ * @see "Seattle University, CPSC5300, Spring 2022"
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "storage_engine.h"
+
+/**
+ * @class WorkStealingPool - a fixed set of threads running one batch of tasks at a time
+ *
+ *      run() deals a batch out in contiguous runs, one run per worker's deque, so neighbouring
+        tasks (e.g. neighbouring block ranges) go to the same thread. A worker takes its own
+        tasks from the front, in order; once its deque is empty it steals from the back of
+        another's, so a worker stuck with slow tasks gets help instead of holding up the batch.
+        The threads wait between batches rather than being started for each one.
+ */
+class WorkStealingPool {
+public:
+    typedef std::function<void(void)> Task;
+
+    /**
+     * start the workers
+     * @param num_threads how many, 0 for one per hardware thread
+     */
+    explicit WorkStealingPool(uint num_threads = 0);
+
+    // stops the workers (after the batch in progress, if any)
+    virtual ~WorkStealingPool();
+
+    // not implemented
+    WorkStealingPool(const WorkStealingPool &other) = delete;
+
+    // not implemented
+    WorkStealingPool &operator=(const WorkStealingPool &other) = delete;
+
+    /**
+     * run a batch of tasks on the workers and wait for all of them to finish.
+     * Tasks must not share anything they write to.
+     * @param tasks the batch, left in place
+     * @throws the first exception a task threw (the rest of the batch still runs)
+     */
+    virtual void run(std::vector<Task> &tasks);
+
+    /**
+     * number of workers
+     */
+    virtual uint size(void) const { return (uint) threads.size(); }
+
+protected:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task *> tasks;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Queue>> queues; // one per worker
+    std::mutex mutex; // guards the rest
+    std::condition_variable start; // a batch was handed out (or the pool is stopping)
+    std::condition_variable finish; // the batch's last task is done
+    u_int32_t batch; // batches handed out so far
+    size_t pending; // tasks of this batch not yet done
+    bool stopping;
+    std::exception_ptr error; // the batch's first exception
+
+    /**
+     * thread body for worker i: wait for a batch, work through it, repeat
+     */
+    virtual void work(uint i);
+
+    /**
+     * the next task for worker i: its own front, else another worker's back, else nullptr
+     */
+    virtual Task *next_task(uint i);
+};